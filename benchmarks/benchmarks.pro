@@ -0,0 +1,17 @@
+TARGET = preyeditor-benchmarks
+TEMPLATE = app
+
+QT += core
+QT -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+include(../src/varianttree.pri)
+
+HEADERS += \
+    documents.h
+
+SOURCES += \
+    documents.cpp \
+    main.cpp
@@ -0,0 +1,159 @@
+#include <QBuffer>
+
+#include "documents.h"
+#include "jsonwriter.h"
+
+namespace {
+
+// fixed seed so every run measures the same documents
+class Random
+{
+public:
+    explicit Random(quint32 seed = 0x2545f491) :
+        m_state(seed)
+    {}
+
+    quint32 next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    double nextDouble()
+    { return next() / 4294967296.0; }
+
+private:
+    quint32 m_state;
+};
+
+QString randomWord(Random& random, int length)
+{
+    QString word(length, Qt::Uninitialized);
+    for (int i = 0; i < length; i++)
+        word[i] = QChar('a' + random.next() % 26);
+    return word;
+}
+
+QVariant record(Random& random, int id)
+{
+    QVariantMap obj;
+    obj.insert("id", id);
+    obj.insert("name", randomWord(random, 8 + random.next() % 8));
+    obj.insert("active", bool(random.next() & 1));
+    obj.insert("score", random.nextDouble() * 1000.0);
+
+    QVariantList tags;
+    for (int i = 0; i < 3; i++)
+        tags.append(randomWord(random, 5));
+    obj.insert("tags", tags);
+
+    return obj;
+}
+
+QVariant wideArray(Random& random, int count)
+{
+    QVariantList arr;
+    arr.reserve(count);
+    for (int i = 0; i < count; i++)
+        arr.append(record(random, i));
+    return arr;
+}
+
+QVariant wideObject(Random& random, int count)
+{
+    QVariantMap obj;
+    for (int i = 0; i < count; i++)
+        obj.insert(QString("key%1").arg(i, 8, 10, QChar('0')), record(random, i));
+    return obj;
+}
+
+// chains of nested objects, close to the reader's depth limit
+QVariant deepNesting(Random& random, int count, int depth)
+{
+    QVariantList arr;
+    arr.reserve(count);
+    for (int i = 0; i < count; i++) {
+        QVariant chain = randomWord(random, 6);
+        for (int level = 0; level < depth; level++) {
+            QVariantMap obj;
+            obj.insert("level", level);
+            obj.insert("next", chain);
+            chain = obj;
+        }
+        arr.append(chain);
+    }
+    return arr;
+}
+
+QVariant longStrings(Random& random, int count, int length)
+{
+    QVariantList arr;
+    arr.reserve(count);
+    for (int i = 0; i < count; i++) {
+        QString str = randomWord(random, length);
+        // escapes and non-ascii text keep the writer honest
+        str[length / 3] = QChar('"');
+        str[length / 2] = QChar(0x00e9);
+        str[2 * length / 3] = QChar('\n');
+        arr.append(str);
+    }
+    return arr;
+}
+
+QVariant numbers(Random& random, int rows, int columns)
+{
+    QVariantList arr;
+    arr.reserve(rows);
+    for (int i = 0; i < rows; i++) {
+        QVariantList row;
+        row.reserve(columns);
+        for (int j = 0; j < columns; j++) {
+            if (j % 2)
+                row.append(qlonglong(random.next()) - 0x7fffffff);
+            else
+                row.append((random.nextDouble() - 0.5) * 1e6);
+        }
+        arr.append(row);
+    }
+    return arr;
+}
+
+QByteArray toJson(const QVariant& value)
+{
+    QByteArray json;
+    QBuffer buffer(&json);
+    buffer.open(QIODevice::WriteOnly);
+
+    JsonWriter writer(&buffer, JsonWriter::Compact);
+    writer.write(value);
+    return json;
+}
+
+Document document(const QString& name, const QVariant& value)
+{
+    Document doc;
+    doc.name = name;
+    doc.value = value;
+    doc.json = toJson(value);
+    return doc;
+}
+
+} // namespace
+
+QList<Document> generateDocuments(double scale)
+{
+    Random random;
+    auto scaled = [scale](int n) {
+        return qMax(1, int(n * scale));
+    };
+
+    QList<Document> docs;
+    docs.append(document("wide-array", wideArray(random, scaled(100000))));
+    docs.append(document("wide-object", wideObject(random, scaled(100000))));
+    docs.append(document("deep-nesting", deepNesting(random, scaled(1000), 512)));
+    docs.append(document("long-strings", longStrings(random, scaled(1000), 10000)));
+    docs.append(document("numbers", numbers(random, scaled(20000), 32)));
+    return docs;
+}
@@ -0,0 +1,20 @@
+#ifndef DOCUMENTS_H
+#define DOCUMENTS_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVariant>
+
+// synthetic documents, each stressing one axis of the engine
+struct Document
+{
+    QString name;
+    QVariant value;
+    QByteArray json;
+};
+
+// scale 1 gives documents of roughly 10 MiB
+QList<Document> generateDocuments(double scale);
+
+#endif // DOCUMENTS_H
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <functional>
+
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+#include "documents.h"
+#include "jsonwriter.h"
+#include "varianttreemodel.h"
+
+namespace {
+
+const int MutationRows = 1000;
+const int DataCalls = 1000000;
+
+struct Options
+{
+    int iterations;
+    QString filter;
+};
+
+struct Format
+{
+    const char* name;
+    VariantTreeModel::DocumentFormat format;
+};
+
+// file formats compared on the same trees
+const Format Formats[] = {
+    { "json", VariantTreeModel::Json },
+    { "cbor", VariantTreeModel::Cbor },
+    { "msgpack", VariantTreeModel::MessagePack }
+};
+
+QByteArray encode(const Document& doc, VariantTreeModel::DocumentFormat format)
+{
+    VariantTreeModel model;
+    model.loadVariantTree(doc.value);
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    model.save(&buffer, format, JsonWriter::Compact);
+    return data;
+}
+
+// walks the whole tree the way a view does, returns the visited cell count
+qint64 traverse(VariantTreeModel& model, const QModelIndex& parent)
+{
+    if (model.canFetchMore(parent))
+        model.fetchMore(parent);
+
+    qint64 cells = 0;
+    int rows = model.rowCount(parent);
+    int columns = model.columnCount(parent);
+
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            QModelIndex index = model.index(row, column, parent);
+            model.data(index, Qt::DisplayRole);
+            model.parent(index);
+            cells++;
+        }
+
+        QModelIndex child = model.index(row, 0, parent);
+        if (model.hasChildren(child))
+            cells += traverse(model, child);
+    }
+
+    return cells;
+}
+
+class Runner
+{
+public:
+    explicit Runner(const Options& options) :
+        m_options(options)
+    {}
+
+    // setup runs untimed before every iteration of body,
+    // bytes defaults to the size of the JSON text
+    void measure(const Document& doc, const QString& operation,
+                 const std::function<void()>& setup, const std::function<void()>& body, qint64 bytes = -1)
+    {
+        QString name = doc.name + "/" + operation;
+        if (!m_options.filter.isEmpty() && !name.contains(m_options.filter))
+            return;
+
+        QTextStream(stderr) << name << endl;
+
+        QVector<double> times;
+        QElapsedTimer timer;
+
+        for (int i = 0; i < m_options.iterations; i++) {
+            if (setup)
+                setup();
+
+            timer.start();
+            body();
+            times.append(timer.nsecsElapsed() / 1e6);
+        }
+
+        std::sort(times.begin(), times.end());
+
+        QVariantMap result;
+        result.insert("document", doc.name);
+        result.insert("operation", operation);
+        result.insert("bytes", bytes < 0 ? doc.json.size() : bytes);
+        result.insert("iterations", times.count());
+        result.insert("minMs", times.first());
+        result.insert("medianMs", times[times.count() / 2]);
+        result.insert("maxMs", times.last());
+        m_results.append(result);
+    }
+
+    const QVariantList& results() const
+    { return m_results; }
+
+private:
+    Options m_options;
+    QVariantList m_results;
+};
+
+void runDocument(Runner& runner, const Document& doc)
+{
+    VariantTreeModel model;
+    model.setParallelLoad(true);
+
+    auto load = [&model, &doc]() {
+        model.loadVariantTree(doc.value);
+        model.fetchMore(QModelIndex());
+    };
+
+    runner.measure(doc, "load", [&model]() {
+        model.destroy();
+    }, [&model, &doc]() {
+        model.loadJson(doc.json);
+    });
+
+    runner.measure(doc, "load-sequential", [&model]() {
+        model.destroy();
+        model.setParallelLoad(false);
+    }, [&model, &doc]() {
+        model.loadJson(doc.json);
+    });
+    model.setParallelLoad(true);
+
+    runner.measure(doc, "traverse", [&model, &doc]() {
+        model.loadVariantTree(doc.value);
+    }, [&model]() {
+        traverse(model, QModelIndex());
+    });
+
+    // frees every item of a fully expanded tree through the node pool
+    runner.measure(doc, "destroy", [&model, &doc]() {
+        model.loadVariantTree(doc.value);
+        traverse(model, QModelIndex());
+    }, [&model]() {
+        model.destroy();
+    });
+
+    runner.measure(doc, "data", load, [&model]() {
+        int rows = model.rowCount();
+        if (rows == 0)
+            return;
+        for (int i = 0; i < DataCalls; i++)
+            model.data(model.index(i % rows, i % 3), Qt::DisplayRole);
+    });
+
+    runner.measure(doc, "save", load, [&model, &doc]() {
+        QByteArray json;
+        json.reserve(doc.json.size());
+        QBuffer buffer(&json);
+        buffer.open(QIODevice::WriteOnly);
+        model.save(&buffer, JsonWriter::Compact);
+    });
+
+    // the same tree through every file format, bytes is the encoded size
+    for (const Format& format : Formats) {
+        QByteArray encoded = encode(doc, format.format);
+
+        runner.measure(doc, QString("load-%1").arg(format.name), [&model]() {
+            model.destroy();
+        }, [&model, &encoded, &format]() {
+            QBuffer buffer(&encoded);
+            buffer.open(QIODevice::ReadOnly);
+            model.load(&buffer, format.format);
+        }, encoded.size());
+
+        runner.measure(doc, QString("save-%1").arg(format.name), load, [&model, &encoded, &format]() {
+            QByteArray data;
+            data.reserve(encoded.size());
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::WriteOnly);
+            model.save(&buffer, format.format, JsonWriter::Compact);
+        }, encoded.size());
+    }
+
+    runner.measure(doc, "insert-rows", load, [&model]() {
+        model.insertRows(model.rowCount() / 2, MutationRows);
+    });
+
+    runner.measure(doc, "remove-rows", load, [&model]() {
+        int count = qMin(MutationRows, model.rowCount());
+        model.removeRows(model.rowCount() - count, count);
+    });
+
+    // arrays reorder in place, object members move into the first member
+    runner.measure(doc, "move-rows", load, [&model]() {
+        int rows = model.rowCount();
+        if (model.rootItem()->isArray()) {
+            int count = qMin(MutationRows, rows);
+            model.moveRows(QModelIndex(), 0, count, QModelIndex(), rows);
+        } else if (rows > 1) {
+            int count = qMin(MutationRows, rows - 1);
+            model.moveRows(QModelIndex(), 1, count, model.index(0, 0), 0);
+        }
+    });
+
+    runner.measure(doc, "undo-remove", [&model, &load]() {
+        load();
+        model.removeRows(0, qMin(MutationRows, model.rowCount()));
+    }, [&model]() {
+        model.undo();
+    });
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("preyeditor-benchmarks");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times loading, traversal, editing and saving of synthetic documents\n"
+                                     "and compares JSON with the CBOR and MessagePack formats.");
+    parser.addHelpOption();
+
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the JSON results to <file>.", "file");
+    QCommandLineOption scaleOption(QStringList() << "s" << "scale", "Document size factor (default 1).", "factor", "1");
+    QCommandLineOption iterationsOption(QStringList() << "n" << "iterations", "Iterations per benchmark (default 5).", "count", "5");
+    QCommandLineOption filterOption(QStringList() << "f" << "filter", "Run only benchmarks whose document/operation name contains <text>.", "text");
+    parser.addOption(outputOption);
+    parser.addOption(scaleOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(filterOption);
+    parser.process(app);
+
+    double scale = parser.value(scaleOption).toDouble();
+    Options options;
+    options.iterations = qMax(1, parser.value(iterationsOption).toInt());
+    options.filter = parser.value(filterOption);
+
+    Runner runner(options);
+    for (const Document& doc : generateDocuments(scale > 0 ? scale : 1.0))
+        runDocument(runner, doc);
+
+    QVariantMap report;
+    report.insert("qt", QString(qVersion()));
+    report.insert("date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    report.insert("scale", scale);
+    report.insert("iterations", options.iterations);
+    report.insert("results", runner.results());
+
+    QFile file;
+    if (parser.isSet(outputOption)) {
+        file.setFileName(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QTextStream(stderr) << file.fileName() << ": " << file.errorString() << endl;
+            return 1;
+        }
+    } else {
+        file.open(stdout, QIODevice::WriteOnly);
+    }
+
+    JsonWriter writer(&file);
+    if (!writer.write(report)) {
+        QTextStream(stderr) << writer.errorString() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,338 @@
+#include <climits>
+
+#include <QByteArray>
+#include <QCborStreamReader>
+#include <QDateTime>
+#include <QUrl>
+#include <QUuid>
+
+#include "cborreader.h"
+
+namespace {
+
+// same nesting limit as QJsonDocument
+const int MaxDepth = 1024;
+
+// integers keep the smallest of int, longlong and ulonglong
+// that holds them, like the YAML core schema resolution
+QVariant integerValue(QCborStreamReader& reader)
+{
+    QVariant value;
+
+    if (reader.isUnsignedInteger()) {
+        quint64 n = reader.toUnsignedInteger();
+        if (n <= quint64(INT_MAX))
+            value = int(n);
+        else if (n <= quint64(LLONG_MAX))
+            value = qlonglong(n);
+        else
+            value = qulonglong(n);
+    } else {
+        // absolute value, where 0 stands for 2^64
+        quint64 n = quint64(reader.toNegativeInteger());
+        if (n == 0)
+            value = -18446744073709551616.0;
+        else if (n <= quint64(INT_MAX) + 1)
+            value = int(-qint64(n));
+        else if (n <= quint64(LLONG_MAX) + 1)
+            value = qlonglong(-qint64(n - 1) - 1);
+        else
+            value = -double(n);
+    }
+
+    reader.next();
+    return value;
+}
+
+bool isNumber(const QVariant& value)
+{
+    switch ((uint)value.type()) {
+    case QVariant::Int:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+    case QMetaType::Float:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+CborReader::CborReader(const char* data, qint64 size) :
+    m_begin(data),
+    m_size(size),
+    m_nodeCount(0),
+    m_documentCount(0),
+    m_progressInterval(0),
+    m_nextProgress(LLONG_MAX),
+    m_errorOffset(-1)
+{ }
+
+void CborReader::setProgressFunc(ProgressFunc func, qint64 interval)
+{
+    m_progressFunc = func;
+    m_progressInterval = interval;
+}
+
+bool CborReader::read(QVariant& value)
+{
+    m_nodeCount = 0;
+    m_documentCount = 0;
+    m_nextProgress = m_progressFunc ? 0 : LLONG_MAX;
+    m_errorString.clear();
+    m_errorOffset = -1;
+
+    if (m_size > INT_MAX) {
+        m_errorString = QStringLiteral("document too large");
+        m_errorOffset = 0;
+        return false;
+    }
+
+    // the reader decodes the mapped bytes in place
+    QCborStreamReader reader(QByteArray::fromRawData(m_begin, int(m_size)));
+
+    QVariantList documents;
+    do {
+        documents.append(QVariant());
+        if (!readValue(reader, documents.last(), 0))
+            return false;
+    } while (reader.currentOffset() < m_size);
+
+    if (reader.lastError() != QCborError::NoError)
+        return setError(reader, reader.lastError().toString());
+
+    m_documentCount = documents.size();
+    if (m_documentCount == 1)
+        value.swap(documents.first());
+    else
+        value = documents;
+
+    return true;
+}
+
+bool CborReader::readValue(QCborStreamReader& reader, QVariant& value, int depth)
+{
+    if (reader.lastError() != QCborError::NoError)
+        return setError(reader, reader.lastError().toString());
+
+    m_nodeCount++;
+
+    if (reader.currentOffset() >= m_nextProgress && !reportProgress(reader))
+        return false;
+
+    switch (reader.type()) {
+    case QCborStreamReader::UnsignedInteger:
+    case QCborStreamReader::NegativeInteger:
+        value = integerValue(reader);
+        return true;
+    case QCborStreamReader::ByteArray: {
+        QByteArray bytes;
+        if (!readBytes(reader, bytes))
+            return false;
+        value = bytes;
+        return true;
+    }
+    case QCborStreamReader::String: {
+        QString str;
+        if (!readString(reader, str))
+            return false;
+        value = str;
+        return true;
+    }
+    case QCborStreamReader::Array:
+        return readArray(reader, value, depth + 1);
+    case QCborStreamReader::Map:
+        return readMap(reader, value, depth + 1);
+    case QCborStreamReader::Tag:
+        return readTagged(reader, value, depth + 1);
+    case QCborStreamReader::SimpleType: {
+        switch (reader.toSimpleType()) {
+        case QCborSimpleType::False:
+            value = false;
+            break;
+        case QCborSimpleType::True:
+            value = true;
+            break;
+        case QCborSimpleType::Null:
+        case QCborSimpleType::Undefined:
+            value = QVariant();
+            break;
+        default:
+            return setError(reader, QStringLiteral("unsupported simple value"));
+        }
+        reader.next();
+        return true;
+    }
+    case QCborStreamReader::Float16:
+        value = double(float(reader.toFloat16()));
+        reader.next();
+        return true;
+    case QCborStreamReader::Float:
+        value = reader.toFloat();
+        reader.next();
+        return true;
+    case QCborStreamReader::Double:
+        value = reader.toDouble();
+        reader.next();
+        return true;
+    default:
+        if (reader.lastError() != QCborError::NoError)
+            return setError(reader, reader.lastError().toString());
+        return setError(reader, QStringLiteral("unexpected end of document"));
+    }
+}
+
+bool CborReader::readArray(QCborStreamReader& reader, QVariant& value, int depth)
+{
+    if (depth > MaxDepth)
+        return setError(reader, QStringLiteral("too deeply nested document"));
+
+    value = QVariantList();
+    QVariantList& arr = *reinterpret_cast<QVariantList*>(value.data());
+
+    // every element takes at least one byte, a bogus length can not over-allocate
+    if (reader.isLengthKnown())
+        arr.reserve(int(qMin<quint64>(reader.length(), quint64(m_size - reader.currentOffset()))));
+
+    if (!reader.enterContainer())
+        return setError(reader, reader.lastError().toString());
+
+    while (reader.hasNext()) {
+        arr.append(QVariant());
+        if (!readValue(reader, arr.last(), depth))
+            return false;
+    }
+
+    if (reader.lastError() != QCborError::NoError || !reader.leaveContainer())
+        return setError(reader, reader.lastError().toString());
+
+    return true;
+}
+
+bool CborReader::readMap(QCborStreamReader& reader, QVariant& value, int depth)
+{
+    if (depth > MaxDepth)
+        return setError(reader, QStringLiteral("too deeply nested document"));
+
+    value = QVariantMap();
+    QVariantMap& obj = *reinterpret_cast<QVariantMap*>(value.data());
+
+    if (!reader.enterContainer())
+        return setError(reader, reader.lastError().toString());
+
+    while (reader.hasNext()) {
+        QString key;
+        if (reader.isString()) {
+            if (!readString(reader, key))
+                return false;
+        } else if (reader.isInteger()) {
+            key = integerValue(reader).toString();
+        } else {
+            return setError(reader, QStringLiteral("map key must be a string or an integer"));
+        }
+
+        // duplicate keys: the last value wins like in QJsonObject
+        if (!readValue(reader, obj[key], depth))
+            return false;
+    }
+
+    if (reader.lastError() != QCborError::NoError || !reader.leaveContainer())
+        return setError(reader, reader.lastError().toString());
+
+    return true;
+}
+
+bool CborReader::readTagged(QCborStreamReader& reader, QVariant& value, int depth)
+{
+    // a chain of tags nests like containers do
+    if (depth > MaxDepth)
+        return setError(reader, QStringLiteral("too deeply nested document"));
+
+    QCborTag tag = reader.toTag();
+    if (!reader.next())
+        return setError(reader, reader.lastError().toString());
+
+    m_nodeCount--;
+    if (!readValue(reader, value, depth))
+        return false;
+
+    // types the tree holds natively, other tags keep the tagged value
+    switch (quint64(tag)) {
+    case quint64(QCborKnownTags::DateTimeString): {
+        if (value.type() == QVariant::String) {
+            QDateTime dateTime = QDateTime::fromString(value.toString(), Qt::ISODateWithMs);
+            if (dateTime.isValid())
+                value = dateTime;
+        }
+        break;
+    }
+    case quint64(QCborKnownTags::UnixTime_t): {
+        if (isNumber(value))
+            value = QDateTime::fromMSecsSinceEpoch(qint64(value.toDouble() * 1000), Qt::UTC);
+        break;
+    }
+    case quint64(QCborKnownTags::Url): {
+        if (value.type() == QVariant::String)
+            value = QUrl(value.toString());
+        break;
+    }
+    case quint64(QCborKnownTags::Uuid): {
+        if (value.type() == QVariant::ByteArray && value.toByteArray().size() == 16)
+            value = QUuid::fromRfc4122(value.toByteArray());
+        break;
+    }
+    default:
+        break;
+    }
+
+    return true;
+}
+
+bool CborReader::readString(QCborStreamReader& reader, QString& str)
+{
+    // definite length strings come in one chunk
+    auto chunk = reader.readString();
+    while (chunk.status == QCborStreamReader::Ok) {
+        str += chunk.data;
+        chunk = reader.readString();
+    }
+
+    if (chunk.status == QCborStreamReader::Error)
+        return setError(reader, reader.lastError().toString());
+
+    return true;
+}
+
+bool CborReader::readBytes(QCborStreamReader& reader, QByteArray& bytes)
+{
+    auto chunk = reader.readByteArray();
+    while (chunk.status == QCborStreamReader::Ok) {
+        bytes += chunk.data;
+        chunk = reader.readByteArray();
+    }
+
+    if (chunk.status == QCborStreamReader::Error)
+        return setError(reader, reader.lastError().toString());
+
+    return true;
+}
+
+bool CborReader::reportProgress(QCborStreamReader& reader)
+{
+    qint64 offset = reader.currentOffset();
+    m_nextProgress = offset + m_progressInterval;
+
+    if (!m_progressFunc(offset, m_nodeCount))
+        return setError(reader, QStringLiteral("loading cancelled"));
+
+    return true;
+}
+
+bool CborReader::setError(QCborStreamReader& reader, const QString& error)
+{
+    m_errorString = error;
+    m_errorOffset = reader.currentOffset();
+    return false;
+}
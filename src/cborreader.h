@@ -0,0 +1,65 @@
+#ifndef CBORREADER_H
+#define CBORREADER_H
+
+#include <functional>
+
+#include <QString>
+#include <QVariant>
+
+class QCborStreamReader;
+
+class CborReader
+{
+    using This = CborReader;
+
+public:
+    // called with the bytes parsed so far and the node count,
+    // returning false cancels the parsing
+    using ProgressFunc = std::function<bool(qint64, qint64)>;
+
+    CborReader(const char* data, qint64 size);
+
+    void setProgressFunc(ProgressFunc func, qint64 interval = 1 << 22);
+
+    // decodes the items straight into QVariantList/QVariantMap nodes,
+    // a sequence of several top-level items is read as an array of them
+    bool read(QVariant& value);
+
+    int documentCount() const
+    { return m_documentCount; }
+
+    // error getters
+    const QString& errorString() const
+    { return m_errorString; }
+    qint64 errorOffset() const
+    { return m_errorOffset; }
+
+    qint64 nodeCount() const
+    { return m_nodeCount; }
+
+private:
+    bool readValue(QCborStreamReader& reader, QVariant& value, int depth);
+    bool readArray(QCborStreamReader& reader, QVariant& value, int depth);
+    bool readMap(QCborStreamReader& reader, QVariant& value, int depth);
+    bool readTagged(QCborStreamReader& reader, QVariant& value, int depth);
+    bool readString(QCborStreamReader& reader, QString& str);
+    bool readBytes(QCborStreamReader& reader, QByteArray& bytes);
+
+    bool reportProgress(QCborStreamReader& reader);
+    bool setError(QCborStreamReader& reader, const QString& error);
+
+    const char* m_begin;
+    qint64 m_size;
+
+    qint64 m_nodeCount;
+    int m_documentCount;
+
+    ProgressFunc m_progressFunc;
+    qint64 m_progressInterval;
+    qint64 m_nextProgress;
+
+    QString m_errorString;
+    qint64 m_errorOffset;
+};
+
+#endif // CBORREADER_H
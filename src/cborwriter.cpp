@@ -0,0 +1,160 @@
+#include <QCborStreamWriter>
+#include <QDateTime>
+#include <QIODevice>
+#include <QUrl>
+#include <QUuid>
+
+#include "cborwriter.h"
+
+namespace {
+
+const int BufferSize = 1 << 20;
+
+} // namespace
+
+CborWriter::CborWriter(QIODevice* device) :
+    m_device(device),
+    m_bytesWritten(0)
+{
+    m_buffer.reserve(BufferSize + 64);
+    m_bufferDevice.setBuffer(&m_buffer);
+}
+
+bool CborWriter::write(const QVariant& value, bool multiDocument)
+{
+    m_errorString.clear();
+
+    m_bufferDevice.open(QIODevice::WriteOnly);
+    QCborStreamWriter writer(&m_bufferDevice);
+
+    if (multiDocument && value.type() == QVariant::List) {
+        for (const QVariant& document : *reinterpret_cast<const QVariantList*>(value.constData()))
+            writeValue(writer, document);
+    } else {
+        writeValue(writer, value);
+    }
+
+    flush();
+    m_bufferDevice.close();
+
+    return m_errorString.isEmpty();
+}
+
+void CborWriter::writeValue(QCborStreamWriter& writer, const QVariant& value)
+{
+    if (!m_errorString.isEmpty())
+        return;
+
+    if (m_buffer.size() >= BufferSize)
+        flush();
+
+    uint type = value.type();
+
+    switch (type) {
+    case QVariant::Invalid: {
+        writer.appendNull();
+        break;
+    }
+    case QVariant::Bool: {
+        writer.append(value.toBool());
+        break;
+    }
+    case QVariant::Int:
+    case QVariant::LongLong: {
+        writer.append(qint64(value.toLongLong()));
+        break;
+    }
+    case QVariant::UInt:
+    case QVariant::ULongLong: {
+        writer.append(quint64(value.toULongLong()));
+        break;
+    }
+    case QVariant::Double: {
+        writer.append(value.toDouble());
+        break;
+    }
+    case QMetaType::Float: {
+        writer.append(value.toFloat());
+        break;
+    }
+    case QVariant::String: {
+        writer.append(QStringView(*reinterpret_cast<const QString*>(value.constData())));
+        break;
+    }
+    case QVariant::ByteArray: {
+        writer.append(*reinterpret_cast<const QByteArray*>(value.constData()));
+        break;
+    }
+    case QVariant::List: {
+        const QVariantList& arr = *reinterpret_cast<const QVariantList*>(value.constData());
+        writer.startArray(quint64(arr.size()));
+        for (const QVariant& item : arr)
+            writeValue(writer, item);
+        writer.endArray();
+        break;
+    }
+    case QVariant::Map: {
+        const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(value.constData());
+        writer.startMap(quint64(obj.size()));
+        for (auto it = obj.constBegin(); it != obj.constEnd(); it++) {
+            writer.append(QStringView(it.key()));
+            writeValue(writer, it.value());
+        }
+        writer.endMap();
+        break;
+    }
+    case QVariant::StringList: {
+        const QStringList& list = *reinterpret_cast<const QStringList*>(value.constData());
+        writer.startArray(quint64(list.size()));
+        for (const QString& str : list)
+            writer.append(QStringView(str));
+        writer.endArray();
+        break;
+    }
+    case QVariant::DateTime: {
+        writer.append(QCborKnownTags::DateTimeString);
+        writer.append(QStringView(value.toDateTime().toString(Qt::ISODateWithMs)));
+        break;
+    }
+    case QVariant::Url: {
+        writer.append(QCborKnownTags::Url);
+        writer.append(QStringView(value.toUrl().toString(QUrl::FullyEncoded)));
+        break;
+    }
+    case QVariant::Uuid: {
+        writer.append(QCborKnownTags::Uuid);
+        writer.append(value.toUuid().toRfc4122());
+        break;
+    }
+    default: {
+        // char, date, time...
+        writer.append(QStringView(value.toString()));
+        break;
+    }
+    }
+}
+
+bool CborWriter::flush()
+{
+    if (m_buffer.isEmpty())
+        return true;
+
+    qint64 size = m_buffer.size();
+    qint64 written = m_errorString.isEmpty() ? m_device->write(m_buffer.constData(), size) : -1;
+
+    // rewind the stream writer and keep the reserved capacity
+    m_bufferDevice.seek(0);
+    m_buffer.resize(0);
+
+    if (written != size) {
+        if (m_errorString.isEmpty())
+            m_errorString = m_device->errorString();
+        return false;
+    }
+
+    m_bytesWritten += written;
+    if (m_progressFunc)
+        m_progressFunc(m_bytesWritten);
+
+    return true;
+}
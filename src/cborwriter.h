@@ -0,0 +1,53 @@
+#ifndef CBORWRITER_H
+#define CBORWRITER_H
+
+#include <functional>
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+class QCborStreamWriter;
+class QIODevice;
+
+class CborWriter
+{
+    using This = CborWriter;
+
+public:
+    using ProgressFunc = std::function<void(qint64)>;
+
+    explicit CborWriter(QIODevice* device);
+
+    // called with the total byte count after each buffer flush
+    void setProgressFunc(const ProgressFunc& func)
+    { m_progressFunc = func; }
+
+    // encodes the value through a fixed size buffer, with multiDocument
+    // the elements of an array are written as a sequence of top-level items
+    bool write(const QVariant& value, bool multiDocument = false);
+
+    qint64 bytesWritten() const
+    { return m_bytesWritten; }
+    const QString& errorString() const
+    { return m_errorString; }
+
+private:
+    void writeValue(QCborStreamWriter& writer, const QVariant& value);
+
+    bool flush();
+
+    QIODevice* m_device;
+
+    // the stream writer appends to m_buffer through m_bufferDevice
+    QByteArray m_buffer;
+    QBuffer m_bufferDevice;
+    qint64 m_bytesWritten;
+
+    ProgressFunc m_progressFunc;
+
+    QString m_errorString;
+};
+
+#endif // CBORWRITER_H
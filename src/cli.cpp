@@ -0,0 +1,385 @@
+#include <cstring>
+#include <functional>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include "cli.h"
+#include "jsonpointer.h"
+#include "jsonquery.h"
+#include "jsonwriter.h"
+#include "varianttreemodel.h"
+
+namespace {
+
+const char* const Commands[] = {
+    "validate",
+    "format",
+    "extract",
+    "query",
+    "convert"
+};
+
+enum ExitCode {
+    Success = 0,
+    InvalidDocument = 1,
+    UsageError = 2,
+    IoError = 3
+};
+
+bool parseFormat(const QString& name, VariantTreeModel::DocumentFormat* format)
+{
+    if (name == "json")
+        *format = VariantTreeModel::Json;
+    else if (name == "yaml")
+        *format = VariantTreeModel::Yaml;
+    else if (name == "cbor")
+        *format = VariantTreeModel::Cbor;
+    else if (name == "msgpack")
+        *format = VariantTreeModel::MessagePack;
+    else
+        return false;
+    return true;
+}
+
+class CommandLine
+{
+public:
+    explicit CommandLine(const QCoreApplication& app);
+
+    int exec();
+
+private:
+    int validate();
+    int format();
+    int extract();
+    int query();
+    int convert();
+
+    // Success, InvalidDocument or IoError
+    int load(VariantTreeModel& model, const QString& fileName);
+    bool write(const QVariant& value);
+    // stdout or an atomically replaced --output file
+    bool writeOutput(const std::function<bool(QIODevice*, QString*)>& func);
+
+    void error(const QString& text);
+    int usage(const QString& text);
+
+    const QCoreApplication& m_app;
+    QCommandLineParser m_parser;
+
+    QCommandLineOption m_compactOption;
+    QCommandLineOption m_outputOption;
+    QCommandLineOption m_toOption;
+    QCommandLineOption m_fromOption;
+    QCommandLineOption m_quietOption;
+
+    QString m_command;
+    QStringList m_args;
+    VariantTreeModel::DocumentFormat m_stdinFormat;
+};
+
+CommandLine::CommandLine(const QCoreApplication& app) :
+    m_app(app),
+    m_compactOption(QStringList() << "c" << "compact", "Write compact output without whitespace."),
+    m_outputOption(QStringList() << "o" << "output", "Write to <file> instead of stdout.", "file"),
+    m_toOption(QStringList() << "t" << "to", "Target format for convert (json, yaml, cbor, msgpack).", "format", "json"),
+    m_fromOption(QStringList() << "f" << "from", "Format of stdin (json, yaml, cbor, msgpack), files go by their suffix.", "format", "json"),
+    m_quietOption(QStringList() << "q" << "quiet", "Print errors only.")
+{
+    m_parser.setApplicationDescription(
+                "Batch processing of JSON documents.\n\n"
+                "Commands:\n"
+                "  validate <files...>         check that the documents parse\n"
+                "  format <file>               pretty-print, or minify with --compact\n"
+                "  extract <pointer> <file>    print the subtree at an RFC 6901 pointer\n"
+                "  query <expression> <file>   print the matches of a JSONPath expression\n"
+                "                              or of a pointer with \"*\" tokens as an array\n"
+                "  convert --to <format> <file>\n\n"
+                "A file name of \"-\" reads stdin. Files ending in .yaml or .yml are YAML,\n"
+                ".cbor is CBOR and .msgpack or .mpk is MessagePack.");
+    m_parser.addHelpOption();
+    m_parser.addVersionOption();
+    m_parser.addOption(m_compactOption);
+    m_parser.addOption(m_outputOption);
+    m_parser.addOption(m_toOption);
+    m_parser.addOption(m_fromOption);
+    m_parser.addOption(m_quietOption);
+    m_parser.addPositionalArgument("command", "validate, format, extract, query or convert.");
+}
+
+int CommandLine::exec()
+{
+    // process() would exit with 1, the code of invalid documents
+    if (!m_parser.parse(m_app.arguments()))
+        return usage(m_parser.errorText());
+
+    if (m_parser.isSet("help")) {
+        QTextStream(stdout) << m_parser.helpText();
+        return Success;
+    }
+    if (m_parser.isSet("version")) {
+        QTextStream(stdout) << QCoreApplication::applicationName() << ' '
+                            << QCoreApplication::applicationVersion() << endl;
+        return Success;
+    }
+
+    m_args = m_parser.positionalArguments();
+    if (m_args.isEmpty())
+        return usage("missing command");
+
+    m_command = m_args.takeFirst();
+
+    QString from = m_parser.value(m_fromOption);
+    if (!parseFormat(from, &m_stdinFormat))
+        return usage(QString("unsupported format \"%1\"").arg(from));
+
+    if (m_command == "validate")
+        return validate();
+    if (m_command == "format")
+        return format();
+    if (m_command == "extract")
+        return extract();
+    if (m_command == "query")
+        return query();
+    if (m_command == "convert")
+        return convert();
+
+    return usage(QString("unknown command \"%1\"").arg(m_command));
+}
+
+int CommandLine::validate()
+{
+    if (m_args.isEmpty())
+        m_args.append("-");
+
+    bool quiet = m_parser.isSet(m_quietOption);
+    int exitCode = Success;
+
+    // one model is reused, loading resets it
+    VariantTreeModel model;
+    for (const QString& fileName : m_args) {
+        int status = load(model, fileName);
+        if (status != Success) {
+            // unreadable files outrank invalid documents
+            if (exitCode != IoError)
+                exitCode = status;
+            continue;
+        }
+
+        if (!quiet)
+            QTextStream(stdout) << fileName << ": ok" << endl;
+    }
+
+    return exitCode;
+}
+
+int CommandLine::format()
+{
+    if (m_args.count() > 1)
+        return usage("format takes one file");
+
+    VariantTreeModel model;
+    int status = load(model, m_args.value(0, "-"));
+    if (status != Success)
+        return status;
+
+    return write(model.variantTree()) ? Success : IoError;
+}
+
+int CommandLine::extract()
+{
+    if (m_args.isEmpty() || m_args.count() > 2)
+        return usage("extract takes a pointer and one file");
+
+    QStringList tokens;
+    if (!JsonPointer::parse(m_args.at(0), &tokens))
+        return usage(QString("invalid pointer \"%1\"").arg(m_args.at(0)));
+
+    VariantTreeModel model;
+    int status = load(model, m_args.value(1, "-"));
+    if (status != Success)
+        return status;
+
+    const QVariant* value = JsonPointer::resolve(model.variantTree(), tokens);
+    if (!value) {
+        error(QString("%1: not found").arg(m_args.at(0)));
+        return InvalidDocument;
+    }
+
+    return write(*value) ? Success : IoError;
+}
+
+int CommandLine::query()
+{
+    if (m_args.isEmpty() || m_args.count() > 2)
+        return usage("query takes an expression and one file");
+
+    JsonQuery jsonQuery;
+    if (!jsonQuery.compile(m_args.at(0))) {
+        return usage(QString("invalid query \"%1\": %2 at offset %3")
+                     .arg(m_args.at(0), jsonQuery.errorString())
+                     .arg(jsonQuery.errorOffset()));
+    }
+
+    VariantTreeModel model;
+    int status = load(model, m_args.value(1, "-"));
+    if (status != Success)
+        return status;
+
+    // the matched values stay shared with the loaded tree
+    QVariantList values;
+    for (const JsonQuery::Match& match : jsonQuery.evaluate(model.variantTree()))
+        values.append(*match.value);
+
+    return write(values) ? Success : IoError;
+}
+
+int CommandLine::convert()
+{
+    if (m_args.count() > 1)
+        return usage("convert takes one file");
+
+    QString to = m_parser.value(m_toOption);
+    VariantTreeModel::DocumentFormat target;
+    if (!parseFormat(to, &target))
+        return usage(QString("unsupported format \"%1\"").arg(to));
+
+    VariantTreeModel model;
+    int status = load(model, m_args.value(0, "-"));
+    if (status != Success)
+        return status;
+
+    // YAML streams and binary sequences of several documents stay separate documents
+    JsonWriter::Format format = m_parser.isSet(m_compactOption) ? JsonWriter::Compact : JsonWriter::Indented;
+    bool ok = writeOutput([&model, target, format](QIODevice* device, QString* errorString) {
+        bool saved = model.save(device, target, format);
+        *errorString = model.errorString();
+        return saved;
+    });
+
+    return ok ? Success : IoError;
+}
+
+int CommandLine::load(VariantTreeModel& model, const QString& fileName)
+{
+    bool ok;
+
+    if (fileName == "-") {
+        QFile in;
+        in.open(stdin, QIODevice::ReadOnly);
+        ok = model.load(&in, m_stdinFormat);
+    } else {
+        ok = model.load(fileName);
+    }
+
+    if (!ok) {
+        if (model.errorLine() > 0) {
+            error(QString("%1:%2: %3 (offset %4)")
+                  .arg(fileName)
+                  .arg(model.errorLine())
+                  .arg(model.errorString())
+                  .arg(model.errorOffset()));
+        } else if (model.errorOffset() >= 0) {
+            // binary formats have no lines
+            error(QString("%1: %2 (offset %3)")
+                  .arg(fileName)
+                  .arg(model.errorString())
+                  .arg(model.errorOffset()));
+        } else {
+            error(QString("%1: %2").arg(fileName, model.errorString()));
+        }
+
+        return model.isIoError() ? IoError : InvalidDocument;
+    }
+
+    return Success;
+}
+
+bool CommandLine::write(const QVariant& value)
+{
+    JsonWriter::Format format = m_parser.isSet(m_compactOption) ? JsonWriter::Compact : JsonWriter::Indented;
+
+    return writeOutput([&value, format](QIODevice* device, QString* errorString) {
+        JsonWriter writer(device, format);
+        bool written = writer.write(value);
+        *errorString = writer.errorString();
+        return written;
+    });
+}
+
+bool CommandLine::writeOutput(const std::function<bool(QIODevice*, QString*)>& func)
+{
+    QString errorString;
+
+    if (!m_parser.isSet(m_outputOption)) {
+        QFile out;
+        out.open(stdout, QIODevice::WriteOnly);
+
+        if (!func(&out, &errorString)) {
+            error(errorString);
+            return false;
+        }
+        return true;
+    }
+
+    // the output is replaced only when the whole document was written
+    QSaveFile out(m_parser.value(m_outputOption));
+    if (!out.open(QIODevice::WriteOnly)) {
+        error(QString("%1: %2").arg(out.fileName(), out.errorString()));
+        return false;
+    }
+
+    if (!func(&out, &errorString)) {
+        out.cancelWriting();
+        error(QString("%1: %2").arg(out.fileName(), errorString));
+        return false;
+    }
+
+    if (!out.commit()) {
+        error(QString("%1: %2").arg(out.fileName(), out.errorString()));
+        return false;
+    }
+
+    return true;
+}
+
+void CommandLine::error(const QString& text)
+{
+    QTextStream(stderr) << text << endl;
+}
+
+int CommandLine::usage(const QString& text)
+{
+    error(QString("%1: %2").arg(QCoreApplication::applicationName(), text));
+    error(QString("Try \"%1 --help\".").arg(QCoreApplication::applicationName()));
+    return UsageError;
+}
+
+} // namespace
+
+bool isCommandLine(int argc, char* argv[])
+{
+    if (argc < 2)
+        return false;
+
+    for (const char* command : Commands) {
+        if (std::strcmp(argv[1], command) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+int runCommandLine(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("preyeditor");
+    QCoreApplication::setApplicationVersion(APP_VERSION);
+
+    CommandLine commandLine(app);
+    return commandLine.exec();
+}
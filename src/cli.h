@@ -0,0 +1,9 @@
+#ifndef CLI_H
+#define CLI_H
+
+// headless batch mode: "preyeditor <command> [options] <files>"
+// runs on a QCoreApplication, widgets and QML are never initialized
+bool isCommandLine(int argc, char* argv[]);
+int runCommandLine(int argc, char* argv[]);
+
+#endif // CLI_H
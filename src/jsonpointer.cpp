@@ -0,0 +1,104 @@
+#include "jsonpointer.h"
+
+namespace JsonPointer {
+
+bool parse(const QString& pointer, QStringList* tokens)
+{
+    tokens->clear();
+
+    if (pointer.isEmpty())
+        return true;
+    if (pointer.at(0) != '/')
+        return false;
+
+    const QChar* it = pointer.constData() + 1;
+    const QChar* itEnd = pointer.constData() + pointer.size();
+
+    QString token;
+    for (; it != itEnd; it++) {
+        if (*it == '/') {
+            tokens->append(token);
+            token.clear();
+        } else if (*it == '~') {
+            if (it + 1 == itEnd)
+                return false;
+            it++;
+            if (*it == '0')
+                token.append('~');
+            else if (*it == '1')
+                token.append('/');
+            else
+                return false;
+        } else {
+            token.append(*it);
+        }
+    }
+
+    tokens->append(token);
+    return true;
+}
+
+QString escape(const QString& token)
+{
+    if (!token.contains('~') && !token.contains('/'))
+        return token;
+
+    QString escaped = token;
+    escaped.replace('~', "~0");
+    escaped.replace('/', "~1");
+    return escaped;
+}
+
+QString join(const QStringList& tokens)
+{
+    QString pointer;
+    for (const QString& token : tokens) {
+        pointer.append('/');
+        pointer.append(escape(token));
+    }
+    return pointer;
+}
+
+const QVariant* resolve(const QVariant& root, const QStringList& tokens)
+{
+    const QVariant* value = &root;
+
+    for (const QString& token : tokens) {
+        if (value->type() == QVariant::List) {
+            const QVariantList& arr = *reinterpret_cast<const QVariantList*>(value->constData());
+            int index = arrayIndex(token);
+            if (index < 0 || index >= arr.count())
+                return nullptr;
+            value = &arr.at(index);
+        } else if (value->type() == QVariant::Map) {
+            const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(value->constData());
+            auto it = obj.constFind(token);
+            if (it == obj.constEnd())
+                return nullptr;
+            value = &it.value();
+        } else {
+            return nullptr;
+        }
+    }
+
+    return value;
+}
+
+int arrayIndex(const QString& token)
+{
+    if (token.isEmpty() || token.size() > 9)
+        return -1;
+    if (token.size() > 1 && token.at(0) == '0')
+        return -1;
+
+    int index = 0;
+    for (QChar ch : token) {
+        if (ch < '0' || ch > '9')
+            return -1;
+        index = index * 10 + (ch.unicode() - '0');
+    }
+
+    return index;
+}
+
+} // namespace JsonPointer
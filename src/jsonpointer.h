@@ -0,0 +1,26 @@
+#ifndef JSONPOINTER_H
+#define JSONPOINTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+// RFC 6901 pointers, e.g. "/servers/0/ports"
+namespace JsonPointer {
+
+// splits a pointer into unescaped reference tokens,
+// the empty pointer refers to the whole document
+bool parse(const QString& pointer, QStringList* tokens);
+
+QString escape(const QString& token);
+QString join(const QStringList& tokens);
+
+// returns nullptr when the pointer does not resolve
+const QVariant* resolve(const QVariant& root, const QStringList& tokens);
+
+// array tokens are decimal numbers without leading zeros
+int arrayIndex(const QString& token);
+
+} // namespace JsonPointer
+
+#endif // JSONPOINTER_H
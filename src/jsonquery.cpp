@@ -0,0 +1,805 @@
+#include <functional>
+
+#include <QtConcurrent>
+
+#include "jsonpointer.h"
+#include "jsonquery.h"
+
+namespace {
+
+// below this many nodes a step is expanded on the calling thread
+const int ParallelThreshold = 256;
+
+bool isNumber(const QVariant& value)
+{
+    switch (value.type()) {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isNameChar(QChar ch)
+{
+    return ch.isLetterOrNumber() || ch == '_' || ch == '-' || ch == '$';
+}
+
+} // namespace
+
+// parsing
+// @@@@@@@
+
+class JsonQuery::Parser
+{
+public:
+    Parser(const QString& text, JsonQuery* query) :
+        m_text(text),
+        m_pos(0),
+        m_query(query)
+    {}
+
+    bool parse()
+    {
+        if (m_text.isEmpty() || m_text.at(0) == '/')
+            return parsePointer();
+        if (m_text.at(0) == '$') {
+            m_pos++;
+            return parsePath();
+        }
+        return fail("a query starts with \"/\" or \"$\"");
+    }
+
+private:
+    bool parsePointer()
+    {
+        QStringList tokens;
+        if (!JsonPointer::parse(m_text, &tokens))
+            return fail("invalid pointer");
+
+        for (const QString& token : tokens) {
+            Step step;
+            step.recursive = false;
+            if (token == "*") {
+                step.selectors.append(selector(Selector::Wildcard));
+            } else {
+                Selector sel = selector(Selector::Member);
+                sel.name = token;
+                sel.index = JsonPointer::arrayIndex(token);
+                step.selectors.append(sel);
+            }
+            m_query->m_steps.append(step);
+        }
+
+        return true;
+    }
+
+    bool parsePath()
+    {
+        forever {
+            skipSpace();
+            if (atEnd())
+                return true;
+
+            Step step;
+            step.recursive = accept("..");
+
+            if (step.recursive || accept('.')) {
+                if (step.recursive && accept('[')) {
+                    if (!parseBracket(step))
+                        return false;
+                } else if (accept('*')) {
+                    step.selectors.append(selector(Selector::Wildcard));
+                } else {
+                    Selector sel = selector(Selector::Member);
+                    if (!parseName(&sel.name))
+                        return fail("expected a member name");
+                    step.selectors.append(sel);
+                }
+            } else if (accept('[')) {
+                if (!parseBracket(step))
+                    return false;
+            } else {
+                return fail("expected \".\" or \"[\"");
+            }
+
+            m_query->m_steps.append(step);
+        }
+    }
+
+    bool parseBracket(Step& step)
+    {
+        skipSpace();
+
+        if (accept('?')) {
+            skipSpace();
+            if (!accept('('))
+                return fail("expected \"(\"");
+
+            Selector sel = selector(Selector::Filter);
+            sel.filter = parseOr();
+            if (sel.filter < 0)
+                return false;
+
+            skipSpace();
+            if (!accept(')'))
+                return fail("expected \")\"");
+            step.selectors.append(sel);
+        } else {
+            do {
+                skipSpace();
+                Selector sel;
+                if (!parseSelector(&sel))
+                    return false;
+                step.selectors.append(sel);
+                skipSpace();
+            } while (accept(','));
+        }
+
+        skipSpace();
+        if (!accept(']'))
+            return fail("expected \"]\"");
+        return true;
+    }
+
+    bool parseSelector(Selector* sel)
+    {
+        if (accept('*')) {
+            *sel = selector(Selector::Wildcard);
+            return true;
+        }
+
+        if (peek() == '\'' || peek() == '"') {
+            *sel = selector(Selector::Member);
+            return parseString(&sel->name);
+        }
+
+        *sel = selector(Selector::Index);
+        if (peek() != ':') {
+            if (!parseInt(&sel->index))
+                return false;
+            skipSpace();
+            if (!accept(':'))
+                return true;
+            sel->start = sel->index;
+            sel->hasStart = true;
+        } else {
+            m_pos++;
+        }
+
+        // [start:end:step] as in Python
+        sel->type = Selector::Slice;
+        skipSpace();
+        if (peek() == '-' || peek().isDigit()) {
+            if (!parseInt(&sel->end))
+                return false;
+            sel->hasEnd = true;
+        }
+
+        skipSpace();
+        if (accept(':')) {
+            skipSpace();
+            if ((peek() == '-' || peek().isDigit()) && !parseInt(&sel->step))
+                return false;
+        }
+
+        return true;
+    }
+
+    // filter expressions, "&&" binds tighter than "||"
+    int parseOr()
+    {
+        int lhs = parseAnd();
+        while (lhs >= 0) {
+            skipSpace();
+            if (!accept("||"))
+                break;
+            int rhs = parseAnd();
+            lhs = rhs < 0 ? -1 : addFilter(FilterNode::Or, lhs, rhs);
+        }
+        return lhs;
+    }
+
+    int parseAnd()
+    {
+        int lhs = parseUnary();
+        while (lhs >= 0) {
+            skipSpace();
+            if (!accept("&&"))
+                break;
+            int rhs = parseUnary();
+            lhs = rhs < 0 ? -1 : addFilter(FilterNode::And, lhs, rhs);
+        }
+        return lhs;
+    }
+
+    int parseUnary()
+    {
+        skipSpace();
+
+        if (accept('!')) {
+            int operand = parseUnary();
+            return operand < 0 ? -1 : addFilter(FilterNode::Not, operand, -1);
+        }
+
+        if (accept('(')) {
+            int expr = parseOr();
+            skipSpace();
+            if (expr >= 0 && !accept(')')) {
+                fail("expected \")\"");
+                return -1;
+            }
+            return expr;
+        }
+
+        return parseComparison();
+    }
+
+    int parseComparison()
+    {
+        FilterNode node;
+        node.type = FilterNode::Exists;
+        node.op = FilterNode::Equal;
+        node.lhs = -1;
+        node.rhs = -1;
+
+        if (!parseOperand(&node.a))
+            return -1;
+
+        skipSpace();
+        if (accept("=="))
+            node.op = FilterNode::Equal;
+        else if (accept("!="))
+            node.op = FilterNode::NotEqual;
+        else if (accept("<="))
+            node.op = FilterNode::LessEqual;
+        else if (accept(">="))
+            node.op = FilterNode::GreaterEqual;
+        else if (accept('<'))
+            node.op = FilterNode::Less;
+        else if (accept('>'))
+            node.op = FilterNode::Greater;
+        else if (!node.a.isPath) {
+            fail("expected a comparison");
+            return -1;
+        } else {
+            m_query->m_filters.append(node);
+            return m_query->m_filters.count() - 1;
+        }
+
+        node.type = FilterNode::Compare;
+        skipSpace();
+        if (!parseOperand(&node.b))
+            return -1;
+
+        m_query->m_filters.append(node);
+        return m_query->m_filters.count() - 1;
+    }
+
+    bool parseOperand(Operand* operand)
+    {
+        operand->isPath = accept('@');
+        if (operand->isPath)
+            return parseRelativePath(&operand->path);
+        return parseLiteral(&operand->literal);
+    }
+
+    // "@.a.b", "@['a'][0]"
+    bool parseRelativePath(QStringList* path)
+    {
+        forever {
+            if (peek() == '.' && peek(1) != '.') {
+                m_pos++;
+                QString name;
+                if (!parseName(&name))
+                    return fail("expected a member name");
+                path->append(name);
+            } else if (accept('[')) {
+                skipSpace();
+                QString token;
+                if (peek() == '\'' || peek() == '"') {
+                    if (!parseString(&token))
+                        return false;
+                } else {
+                    int index;
+                    if (!parseInt(&index))
+                        return false;
+                    if (index < 0)
+                        return fail("negative indexes are not supported in filters");
+                    token = QString::number(index);
+                }
+                skipSpace();
+                if (!accept(']'))
+                    return fail("expected \"]\"");
+                path->append(token);
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool parseLiteral(QVariant* literal)
+    {
+        if (peek() == '\'' || peek() == '"') {
+            QString str;
+            if (!parseString(&str))
+                return false;
+            *literal = str;
+            return true;
+        }
+
+        if (accept("true")) {
+            *literal = true;
+            return true;
+        }
+        if (accept("false")) {
+            *literal = false;
+            return true;
+        }
+        if (accept("null")) {
+            *literal = QVariant();
+            return true;
+        }
+
+        int start = m_pos;
+        while (!atEnd() && (peek().isDigit() || peek() == '-' || peek() == '+' || peek() == '.'
+                            || peek() == 'e' || peek() == 'E'))
+            m_pos++;
+
+        bool ok = false;
+        double number = m_text.midRef(start, m_pos - start).toDouble(&ok);
+        if (!ok) {
+            m_pos = start;
+            return fail("expected a value");
+        }
+
+        *literal = number;
+        return true;
+    }
+
+    bool parseName(QString* name)
+    {
+        int start = m_pos;
+        while (!atEnd() && isNameChar(peek()))
+            m_pos++;
+
+        *name = m_text.mid(start, m_pos - start);
+        return !name->isEmpty();
+    }
+
+    bool parseString(QString* str)
+    {
+        QChar quote = m_text.at(m_pos++);
+        str->clear();
+
+        while (!atEnd()) {
+            QChar ch = m_text.at(m_pos++);
+            if (ch == quote)
+                return true;
+            if (ch != '\\') {
+                str->append(ch);
+                continue;
+            }
+
+            if (atEnd())
+                break;
+            ch = m_text.at(m_pos++);
+            switch (ch.unicode()) {
+            case 'b': str->append('\b'); break;
+            case 'f': str->append('\f'); break;
+            case 'n': str->append('\n'); break;
+            case 'r': str->append('\r'); break;
+            case 't': str->append('\t'); break;
+            case 'u': {
+                bool ok = false;
+                ushort code = m_text.midRef(m_pos, 4).toUShort(&ok, 16);
+                if (!ok)
+                    return fail("invalid escape sequence");
+                str->append(QChar(code));
+                m_pos += 4;
+                break;
+            }
+            default:
+                str->append(ch);
+            }
+        }
+
+        return fail("unterminated string");
+    }
+
+    bool parseInt(int* value)
+    {
+        int start = m_pos;
+        accept('-');
+        while (!atEnd() && peek().isDigit())
+            m_pos++;
+
+        bool ok = false;
+        *value = m_text.midRef(start, m_pos - start).toInt(&ok);
+        if (!ok) {
+            m_pos = start;
+            return fail("expected a number");
+        }
+        return true;
+    }
+
+    int addFilter(FilterNode::Type type, int lhs, int rhs)
+    {
+        FilterNode node;
+        node.type = type;
+        node.op = FilterNode::Equal;
+        node.lhs = lhs;
+        node.rhs = rhs;
+        m_query->m_filters.append(node);
+        return m_query->m_filters.count() - 1;
+    }
+
+    static Selector selector(Selector::Type type)
+    {
+        Selector sel;
+        sel.type = type;
+        sel.index = -1;
+        sel.start = 0;
+        sel.end = 0;
+        sel.step = 1;
+        sel.hasStart = false;
+        sel.hasEnd = false;
+        sel.filter = -1;
+        return sel;
+    }
+
+    bool atEnd() const
+    { return m_pos >= m_text.size(); }
+    QChar peek(int ahead = 0) const
+    { return m_pos + ahead < m_text.size() ? m_text.at(m_pos + ahead) : QChar(); }
+
+    void skipSpace()
+    {
+        while (!atEnd() && peek().isSpace())
+            m_pos++;
+    }
+
+    bool accept(QChar ch)
+    {
+        if (peek() != ch)
+            return false;
+        m_pos++;
+        return true;
+    }
+
+    bool accept(const char* literal)
+    {
+        QLatin1String str(literal);
+        if (!m_text.midRef(m_pos).startsWith(str))
+            return false;
+        m_pos += str.size();
+        return true;
+    }
+
+    bool fail(const QString& text)
+    {
+        m_query->m_errorString = text;
+        m_query->m_errorOffset = m_pos;
+        return false;
+    }
+
+    QString m_text;
+    int m_pos;
+    JsonQuery* m_query;
+};
+
+// evaluation
+// @@@@@@@@@@
+
+class JsonQuery::Evaluator
+{
+public:
+    explicit Evaluator(const JsonQuery& query) :
+        m_query(query)
+    {}
+
+    QVector<Match> expand(const QVector<Match>& nodes, const Step& step) const
+    {
+        QVector<Match> out;
+
+        if (step.recursive) {
+            // subtrees are independent, the descent below each node is split among them
+            for (const Match& node : nodes) {
+                select(node, step, out);
+
+                QVector<Match> children = childs(node);
+                if (children.count() < 2) {
+                    for (const Match& child : children)
+                        descend(child, step, out);
+                    continue;
+                }
+
+                std::function<QVector<Match>(const Match&)> descendFunc = [this, &step](const Match& child) {
+                    QVector<Match> matches;
+                    descend(child, step, matches);
+                    return matches;
+                };
+                for (const QVector<Match>& matches : QtConcurrent::blockingMapped<QVector<QVector<Match>>>(children, descendFunc))
+                    out += matches;
+            }
+            return out;
+        }
+
+        if (nodes.count() < ParallelThreshold) {
+            for (const Match& node : nodes)
+                select(node, step, out);
+            return out;
+        }
+
+        std::function<QVector<Match>(const Match&)> selectFunc = [this, &step](const Match& node) {
+            QVector<Match> matches;
+            select(node, step, matches);
+            return matches;
+        };
+        for (const QVector<Match>& matches : QtConcurrent::blockingMapped<QVector<QVector<Match>>>(nodes, selectFunc))
+            out += matches;
+        return out;
+    }
+
+private:
+    void descend(const Match& node, const Step& step, QVector<Match>& out) const
+    {
+        select(node, step, out);
+        for (const Match& child : childs(node))
+            descend(child, step, out);
+    }
+
+    void select(const Match& node, const Step& step, QVector<Match>& out) const
+    {
+        for (const Selector& sel : step.selectors)
+            select(node, sel, out);
+    }
+
+    void select(const Match& node, const Selector& sel, QVector<Match>& out) const
+    {
+        if (node.value->type() == QVariant::List) {
+            const QVariantList& arr = *reinterpret_cast<const QVariantList*>(node.value->constData());
+            int count = arr.count();
+
+            switch (sel.type) {
+            case Selector::Member:
+            case Selector::Index: {
+                int index = sel.index < 0 && sel.type == Selector::Index ? count + sel.index : sel.index;
+                if (index >= 0 && index < count)
+                    out.append(child(node, index, &arr.at(index)));
+                break;
+            }
+            case Selector::Wildcard:
+                for (int i = 0; i < count; i++)
+                    out.append(child(node, i, &arr.at(i)));
+                break;
+            case Selector::Slice: {
+                if (sel.step == 0)
+                    break;
+                int first = sel.hasStart ? clampIndex(sel.start, count, sel.step) : (sel.step > 0 ? 0 : count - 1);
+                int last = sel.hasEnd ? clampIndex(sel.end, count, sel.step) : (sel.step > 0 ? count : -1);
+                for (int i = first; sel.step > 0 ? i < last : i > last; i += sel.step)
+                    out.append(child(node, i, &arr.at(i)));
+                break;
+            }
+            case Selector::Filter:
+                for (int i = 0; i < count; i++) {
+                    if (test(sel.filter, arr.at(i)))
+                        out.append(child(node, i, &arr.at(i)));
+                }
+                break;
+            }
+        } else if (node.value->type() == QVariant::Map) {
+            const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(node.value->constData());
+
+            switch (sel.type) {
+            case Selector::Member: {
+                auto it = obj.constFind(sel.name);
+                if (it != obj.constEnd())
+                    out.append(child(node, &it.key(), &it.value()));
+                break;
+            }
+            case Selector::Wildcard:
+                for (auto it = obj.constBegin(); it != obj.constEnd(); it++)
+                    out.append(child(node, &it.key(), &it.value()));
+                break;
+            case Selector::Filter:
+                for (auto it = obj.constBegin(); it != obj.constEnd(); it++) {
+                    if (test(sel.filter, it.value()))
+                        out.append(child(node, &it.key(), &it.value()));
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    bool test(int filter, const QVariant& value) const
+    {
+        const FilterNode& node = m_query.m_filters.at(filter);
+
+        switch (node.type) {
+        case FilterNode::Or:
+            return test(node.lhs, value) || test(node.rhs, value);
+        case FilterNode::And:
+            return test(node.lhs, value) && test(node.rhs, value);
+        case FilterNode::Not:
+            return !test(node.lhs, value);
+        case FilterNode::Exists:
+            return operand(node.a, value) != nullptr;
+        case FilterNode::Compare:
+            return compare(operand(node.a, value), operand(node.b, value), node.op);
+        }
+
+        return false;
+    }
+
+    static const QVariant* operand(const Operand& operand, const QVariant& value)
+    {
+        if (!operand.isPath)
+            return &operand.literal;
+        return JsonPointer::resolve(value, operand.path);
+    }
+
+    static bool compare(const QVariant* a, const QVariant* b, FilterNode::Op op)
+    {
+        if (!a || !b)
+            return false;
+
+        int cmp;
+        if (isNumber(*a) && isNumber(*b)) {
+            double x = a->toDouble();
+            double y = b->toDouble();
+            cmp = x < y ? -1 : (x > y ? 1 : 0);
+        } else if (a->type() == QVariant::String && b->type() == QVariant::String) {
+            cmp = QString::compare(a->toString(), b->toString());
+        } else {
+            // booleans, nulls and containers are only equal or not
+            bool equal = a->type() == b->type() && *a == *b;
+            if (op == FilterNode::Equal)
+                return equal;
+            if (op == FilterNode::NotEqual)
+                return !equal;
+            return false;
+        }
+
+        switch (op) {
+        case FilterNode::Equal:
+            return cmp == 0;
+        case FilterNode::NotEqual:
+            return cmp != 0;
+        case FilterNode::Less:
+            return cmp < 0;
+        case FilterNode::LessEqual:
+            return cmp <= 0;
+        case FilterNode::Greater:
+            return cmp > 0;
+        case FilterNode::GreaterEqual:
+            return cmp >= 0;
+        }
+
+        return false;
+    }
+
+    static QVector<Match> childs(const Match& node)
+    {
+        QVector<Match> out;
+
+        if (node.value->type() == QVariant::List) {
+            const QVariantList& arr = *reinterpret_cast<const QVariantList*>(node.value->constData());
+            out.reserve(arr.count());
+            for (int i = 0; i < arr.count(); i++)
+                out.append(child(node, i, &arr.at(i)));
+        } else if (node.value->type() == QVariant::Map) {
+            const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(node.value->constData());
+            out.reserve(obj.count());
+            for (auto it = obj.constBegin(); it != obj.constEnd(); it++)
+                out.append(child(node, &it.key(), &it.value()));
+        }
+
+        return out;
+    }
+
+    // a child only links to its parent, the tokens are not copied down the tree
+    static Match child(const Match& node, const QString* key, const QVariant* value)
+    {
+        return child(node, key, -1, value);
+    }
+
+    static Match child(const Match& node, int index, const QVariant* value)
+    {
+        return child(node, nullptr, index, value);
+    }
+
+    static Match child(const Match& node, const QString* key, int index, const QVariant* value)
+    {
+        QSharedPointer<PathLink> link = QSharedPointer<PathLink>::create();
+        link->parent = node.path;
+        link->key = key;
+        link->index = index;
+
+        Match match;
+        match.value = value;
+        match.path = link;
+        return match;
+    }
+
+    static int clampIndex(int index, int count, int step)
+    {
+        if (index < 0)
+            index += count;
+        if (step > 0)
+            return qBound(0, index, count);
+        return qBound(-1, index, count - 1);
+    }
+
+    const JsonQuery& m_query;
+};
+
+JsonQuery::JsonQuery() :
+    m_errorOffset(-1)
+{
+}
+
+JsonQuery::JsonQuery(const QString& expression) :
+    m_errorOffset(-1)
+{
+    compile(expression);
+}
+
+bool JsonQuery::compile(const QString& expression)
+{
+    m_steps.clear();
+    m_filters.clear();
+    m_errorString.clear();
+    m_errorOffset = -1;
+
+    Parser parser(expression.trimmed(), this);
+    if (parser.parse())
+        return true;
+
+    m_steps.clear();
+    m_filters.clear();
+    return false;
+}
+
+QStringList JsonQuery::Match::tokens() const
+{
+    QVector<const PathLink*> links;
+    for (const PathLink* link = path.data(); link; link = link->parent.data())
+        links.append(link);
+
+    QStringList tokens;
+    tokens.reserve(links.count());
+    for (int i = links.count() - 1; i >= 0; i--) {
+        const PathLink* link = links.at(i);
+        tokens.append(link->key ? *link->key : QString::number(link->index));
+    }
+
+    return tokens;
+}
+
+QVector<JsonQuery::Match> JsonQuery::evaluate(const QVariant& root) const
+{
+    QVector<Match> nodes;
+    if (!isValid())
+        return nodes;
+
+    Match match;
+    match.value = &root;
+    nodes.append(match);
+
+    Evaluator evaluator(*this);
+    for (const Step& step : m_steps) {
+        nodes = evaluator.expand(nodes, step);
+        if (nodes.isEmpty())
+            break;
+    }
+
+    return nodes;
+}
@@ -0,0 +1,105 @@
+#ifndef JSONQUERY_H
+#define JSONQUERY_H
+
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+// compiled selection of values, either a JSON Pointer where a "*"
+// token matches every child, e.g. "/servers/*/ports", or a JSONPath
+// expression, e.g. "$..[?(@.enabled == false)]"
+class JsonQuery
+{
+public:
+    // one step of a match path, shared by all matches below it
+    struct PathLink
+    {
+        QSharedPointer<const PathLink> parent;
+        // the member key in the evaluated tree, or null for an array index
+        const QString* key;
+        int index;
+    };
+
+    struct Match
+    {
+        // reference tokens from the root, array indexes as numbers,
+        // built from the path links on request
+        QStringList tokens() const;
+
+        // points into the evaluated tree
+        const QVariant* value;
+        QSharedPointer<const PathLink> path;
+    };
+
+    JsonQuery();
+    explicit JsonQuery(const QString& expression);
+
+    bool compile(const QString& expression);
+
+    bool isValid() const
+    { return m_errorOffset < 0; }
+    const QString& errorString() const
+    { return m_errorString; }
+    int errorOffset() const
+    { return m_errorOffset; }
+
+    // matches in document order, wildcards and recursive descent
+    // are expanded on all cores
+    QVector<Match> evaluate(const QVariant& root) const;
+
+private:
+    class Parser;
+    class Evaluator;
+
+    struct Operand
+    {
+        bool isPath;
+        QStringList path;
+        QVariant literal;
+    };
+
+    struct FilterNode
+    {
+        enum Type { Or, And, Not, Exists, Compare };
+        enum Op { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+        Type type;
+        Op op;
+        int lhs;
+        int rhs;
+        Operand a;
+        Operand b;
+    };
+
+    struct Selector
+    {
+        enum Type { Member, Index, Wildcard, Slice, Filter };
+
+        Type type;
+        QString name;
+        // member index into arrays, or the (negative) array index
+        int index;
+        int start;
+        int end;
+        int step;
+        bool hasStart;
+        bool hasEnd;
+        int filter;
+    };
+
+    struct Step
+    {
+        bool recursive;
+        QVector<Selector> selectors;
+    };
+
+    QVector<Step> m_steps;
+    QVector<FilterNode> m_filters;
+
+    QString m_errorString;
+    int m_errorOffset;
+};
+
+#endif // JSONQUERY_H
@@ -0,0 +1,679 @@
+#include <cstring>
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtNumeric>
+
+#include "jsonreader.h"
+
+namespace {
+
+// same nesting limit as QJsonDocument
+const int MaxDepth = 1024;
+
+// doubles that are exactly representable
+const double PowersOf10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool isDigit(char c)
+{ return c >= '0' && c <= '9'; }
+
+void appendUtf8(QByteArray& buffer, uint ucs)
+{
+    if (ucs < 0x80) {
+        buffer.append(char(ucs));
+    } else if (ucs < 0x800) {
+        buffer.append(char(0xc0 | (ucs >> 6)));
+        buffer.append(char(0x80 | (ucs & 0x3f)));
+    } else if (ucs < 0x10000) {
+        buffer.append(char(0xe0 | (ucs >> 12)));
+        buffer.append(char(0x80 | ((ucs >> 6) & 0x3f)));
+        buffer.append(char(0x80 | (ucs & 0x3f)));
+    } else {
+        buffer.append(char(0xf0 | (ucs >> 18)));
+        buffer.append(char(0x80 | ((ucs >> 12) & 0x3f)));
+        buffer.append(char(0x80 | ((ucs >> 6) & 0x3f)));
+        buffer.append(char(0x80 | (ucs & 0x3f)));
+    }
+}
+
+} // namespace
+
+JsonReader::JsonReader(const char* data, qint64 size) :
+    m_begin(data),
+    m_pos(data),
+    m_end(data + size),
+    m_nodeCount(0),
+    m_progressInterval(0),
+    m_nextProgress(data + size),
+    m_errorOffset(-1)
+{ }
+
+void JsonReader::setProgressFunc(ProgressFunc func, qint64 interval)
+{
+    m_progressFunc = func;
+    m_progressInterval = interval;
+}
+
+bool JsonReader::read(QVariant& value)
+{
+    start();
+
+    if (!parseValue(value, 0))
+        return false;
+
+    return finish();
+}
+
+bool JsonReader::readParallel(QVariant& value)
+{
+    start();
+
+    if (m_pos >= m_end || *m_pos != '[')
+        return read(value);
+
+    // structural pre-scan: split the top-level array at element
+    // boundaries into chunks of roughly the same byte size
+
+    struct Chunk
+    {
+        const char* begin;
+        const char* end;
+        int first;
+        int count;
+
+        qint64 nodeCount;
+        QString errorString;
+        qint64 errorOffset;
+    };
+
+    const char* open = m_pos;
+    const qint64 chunkSize = qMax<qint64>((m_end - open) / (QThread::idealThreadCount() * 8), 1 << 16);
+
+    QVector<Chunk> chunks;
+    const char* chunkBegin = open + 1;
+    const char* close = nullptr;
+    int elements = 0;
+    int chunkFirst = 0;
+    int depth = 0;
+    bool inString = false;
+    bool broken = false;
+
+    for (const char* p = open + 1; p < m_end && !close && !broken; p++) {
+        char c = *p;
+        if (inString) {
+            if (c == '\\')
+                p++;
+            else if (c == '"')
+                inString = false;
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            inString = true;
+            break;
+        case '[':
+        case '{':
+            depth++;
+            break;
+        case ']':
+        case '}':
+            if (depth > 0)
+                depth--;
+            else if (c == ']')
+                close = p;
+            else
+                broken = true;
+            break;
+        case ',':
+            if (depth == 0) {
+                elements++;
+                if (p - chunkBegin >= chunkSize) {
+                    chunks.append({ chunkBegin, p, chunkFirst, elements - chunkFirst, 0, QString(), -1 });
+                    chunkBegin = p + 1;
+                    chunkFirst = elements;
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // small or malformed documents: the sequential parser reports the exact error
+    if (!close || chunks.isEmpty())
+        return read(value);
+
+    elements++;
+    chunks.append({ chunkBegin, close, chunkFirst, elements - chunkFirst, 0, QString(), -1 });
+
+    value = QVariantList();
+    QVariantList& arr = *reinterpret_cast<QVariantList*>(value.data());
+    arr.reserve(elements);
+    for (int i = 0; i < elements; i++)
+        arr.append(QVariant());
+
+    // chunks only write to their own slots, the list itself is not resized
+    const QVariantList::iterator elementsBegin = arr.begin();
+
+    QAtomicInteger<qint64> bytesDone(0);
+    QAtomicInteger<qint64> nodesDone(0);
+    QAtomicInt cancelled(0);
+
+    auto parseChunk = [&](Chunk& chunk) {
+        JsonReader reader(m_begin, m_end - m_begin);
+
+        if (m_progressFunc) {
+            qint64 lastBytes = chunk.begin - m_begin;
+            qint64 lastNodes = 0;
+
+            reader.setProgressFunc([&, lastBytes, lastNodes](qint64 bytesProcessed, qint64 nodeCount) mutable {
+                qint64 bytes = bytesDone.fetchAndAddOrdered(bytesProcessed - lastBytes) + bytesProcessed - lastBytes;
+                qint64 nodes = nodesDone.fetchAndAddOrdered(nodeCount - lastNodes) + nodeCount - lastNodes;
+                lastBytes = bytesProcessed;
+                lastNodes = nodeCount;
+
+                if (cancelled.load() || !m_progressFunc(bytes, nodes)) {
+                    cancelled.store(1);
+                    return false;
+                }
+                return true;
+            }, m_progressInterval);
+        }
+
+        if (!reader.parseElements(elementsBegin + chunk.first, chunk.count, chunk.begin, chunk.end)) {
+            chunk.errorString = reader.m_errorString;
+            chunk.errorOffset = reader.m_errorOffset;
+        }
+        chunk.nodeCount = reader.m_nodeCount;
+    };
+
+    QtConcurrent::blockingMap(chunks, parseChunk);
+
+    m_nodeCount = 1;
+    const Chunk* failed = nullptr;
+    for (const Chunk& chunk : chunks) {
+        m_nodeCount += chunk.nodeCount;
+        if (chunk.errorOffset >= 0 && (!failed || chunk.errorOffset < failed->errorOffset))
+            failed = &chunk;
+    }
+
+    if (failed) {
+        m_pos = m_begin + failed->errorOffset;
+        return setError(failed->errorString);
+    }
+
+    m_pos = close + 1;
+    return finish();
+}
+
+void JsonReader::start()
+{
+    m_pos = m_begin;
+    m_nodeCount = 0;
+    m_errorString.clear();
+    m_errorOffset = -1;
+
+    if (m_progressFunc && m_progressInterval < m_end - m_begin)
+        m_nextProgress = m_begin + m_progressInterval;
+    else
+        m_nextProgress = m_end;
+
+    // skip UTF-8 BOM
+    if (m_end - m_pos >= 3
+            && uchar(m_pos[0]) == 0xef
+            && uchar(m_pos[1]) == 0xbb
+            && uchar(m_pos[2]) == 0xbf)
+        m_pos += 3;
+
+    skipWhitespace();
+}
+
+bool JsonReader::finish()
+{
+    skipWhitespace();
+    if (m_pos != m_end)
+        return setError(QStringLiteral("garbage at the end of the document"));
+
+    return true;
+}
+
+bool JsonReader::parseElements(QVariantList::iterator it, int count, const char* begin, const char* end)
+{
+    m_pos = begin;
+    m_end = end;
+
+    if (m_progressFunc && m_progressInterval < m_end - m_pos)
+        m_nextProgress = m_pos + m_progressInterval;
+    else
+        m_nextProgress = m_end;
+
+    for (int i = 0; i < count; i++) {
+        skipWhitespace();
+        if (!parseValue(*it, 1))
+            return false;
+        ++it;
+
+        skipWhitespace();
+        if (i + 1 < count) {
+            if (m_pos >= m_end || *m_pos != ',')
+                return setError(QStringLiteral("missing value separator"));
+            m_pos++;
+        }
+    }
+
+    if (m_pos != m_end)
+        return setError(QStringLiteral("missing value separator"));
+
+    return true;
+}
+
+int JsonReader::errorLine() const
+{
+    if (m_errorOffset < 0)
+        return 0;
+
+    int line = 1;
+    const char* end = m_begin + m_errorOffset;
+    for (const char* p = m_begin; p < end; p++) {
+        if (*p == '\n')
+            line++;
+    }
+    return line;
+}
+
+bool JsonReader::parseValue(QVariant& value, int depth)
+{
+    if (m_pos >= m_end)
+        return setError(QStringLiteral("unexpected end of document"));
+
+    m_nodeCount++;
+
+    if (m_pos >= m_nextProgress && !reportProgress())
+        return false;
+
+    switch (*m_pos) {
+    case '{':
+        return parseObject(value, depth + 1);
+    case '[':
+        return parseArray(value, depth + 1);
+    case '"': {
+        QString str;
+        if (!parseString(str))
+            return false;
+        value = str;
+        return true;
+    }
+    case 't': {
+        if (!parseLiteral("true", 4))
+            return false;
+        value = true;
+        return true;
+    }
+    case 'f': {
+        if (!parseLiteral("false", 5))
+            return false;
+        value = false;
+        return true;
+    }
+    case 'n': {
+        if (!parseLiteral("null", 4))
+            return false;
+        value = QVariant();
+        return true;
+    }
+    default:
+        return parseNumber(value);
+    }
+}
+
+bool JsonReader::parseArray(QVariant& value, int depth)
+{
+    if (depth > MaxDepth)
+        return setError(QStringLiteral("too deeply nested document"));
+
+    m_pos++; // [
+
+    value = QVariantList();
+    QVariantList& arr = *reinterpret_cast<QVariantList*>(value.data());
+
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == ']') {
+        m_pos++;
+        return true;
+    }
+
+    forever {
+        arr.append(QVariant());
+
+        skipWhitespace();
+        if (!parseValue(arr.last(), depth))
+            return false;
+
+        skipWhitespace();
+        if (m_pos >= m_end)
+            return setError(QStringLiteral("unterminated array"));
+
+        char c = *m_pos;
+        if (c == ']') {
+            m_pos++;
+            break;
+        }
+        if (c != ',')
+            return setError(QStringLiteral("missing value separator"));
+        m_pos++;
+    }
+
+    return true;
+}
+
+bool JsonReader::parseObject(QVariant& value, int depth)
+{
+    if (depth > MaxDepth)
+        return setError(QStringLiteral("too deeply nested document"));
+
+    m_pos++; // {
+
+    value = QVariantMap();
+    QVariantMap& obj = *reinterpret_cast<QVariantMap*>(value.data());
+
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == '}') {
+        m_pos++;
+        return true;
+    }
+
+    forever {
+        skipWhitespace();
+        if (m_pos >= m_end || *m_pos != '"')
+            return setError(QStringLiteral("object key expected"));
+
+        QString key;
+        if (!parseString(key))
+            return false;
+
+        skipWhitespace();
+        if (m_pos >= m_end || *m_pos != ':')
+            return setError(QStringLiteral("missing name separator"));
+        m_pos++;
+
+        // duplicate keys: the last value wins like in QJsonObject
+        skipWhitespace();
+        if (!parseValue(obj[key], depth))
+            return false;
+
+        skipWhitespace();
+        if (m_pos >= m_end)
+            return setError(QStringLiteral("unterminated object"));
+
+        char c = *m_pos;
+        if (c == '}') {
+            m_pos++;
+            break;
+        }
+        if (c != ',')
+            return setError(QStringLiteral("missing value separator"));
+        m_pos++;
+    }
+
+    return true;
+}
+
+bool JsonReader::parseString(QString& str)
+{
+    m_pos++; // "
+
+    // fast path: no escape sequences
+    const char* start = m_pos;
+    while (m_pos < m_end) {
+        uchar c = *m_pos;
+        if (c == '"') {
+            str = QString::fromUtf8(start, int(m_pos - start));
+            m_pos++;
+            return true;
+        }
+        if (c == '\\')
+            break;
+        if (c < 0x20)
+            return setError(QStringLiteral("control character in string"));
+        m_pos++;
+    }
+
+    QByteArray buffer(start, int(m_pos - start));
+
+    while (m_pos < m_end) {
+        start = m_pos;
+        while (m_pos < m_end) {
+            uchar c = *m_pos;
+            if (c == '"' || c == '\\')
+                break;
+            if (c < 0x20)
+                return setError(QStringLiteral("control character in string"));
+            m_pos++;
+        }
+        buffer.append(start, int(m_pos - start));
+
+        if (m_pos >= m_end)
+            break;
+
+        if (*m_pos == '"') {
+            str = QString::fromUtf8(buffer);
+            m_pos++;
+            return true;
+        }
+
+        m_pos++; // backslash
+        if (m_pos >= m_end)
+            break;
+
+        switch (*m_pos) {
+        case '"':  buffer.append('"');  break;
+        case '\\': buffer.append('\\'); break;
+        case '/':  buffer.append('/');  break;
+        case 'b':  buffer.append('\b'); break;
+        case 'f':  buffer.append('\f'); break;
+        case 'n':  buffer.append('\n'); break;
+        case 'r':  buffer.append('\r'); break;
+        case 't':  buffer.append('\t'); break;
+        case 'u': {
+            m_pos++;
+            uint ucs;
+            if (!parseHex4(ucs))
+                return false;
+
+            if (ucs >= 0xd800 && ucs < 0xdc00) {
+                uint low;
+                if (m_end - m_pos < 6 || m_pos[0] != '\\' || m_pos[1] != 'u')
+                    return setError(QStringLiteral("invalid surrogate pair"));
+                m_pos += 2;
+                if (!parseHex4(low))
+                    return false;
+                if (low < 0xdc00 || low >= 0xe000)
+                    return setError(QStringLiteral("invalid surrogate pair"));
+                ucs = 0x10000 + ((ucs - 0xd800) << 10) + (low - 0xdc00);
+            } else if (ucs >= 0xdc00 && ucs < 0xe000) {
+                return setError(QStringLiteral("invalid surrogate pair"));
+            }
+
+            appendUtf8(buffer, ucs);
+            continue;
+        }
+        default:
+            return setError(QStringLiteral("invalid escape sequence"));
+        }
+        m_pos++;
+    }
+
+    return setError(QStringLiteral("unterminated string"));
+}
+
+bool JsonReader::parseNumber(QVariant& value)
+{
+    const char* start = m_pos;
+
+    bool negative = false;
+    if (*m_pos == '-') {
+        negative = true;
+        m_pos++;
+    }
+
+    if (m_pos >= m_end || !isDigit(*m_pos)) {
+        m_pos = start;
+        return setError(QStringLiteral("illegal value"));
+    }
+
+    quint64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+
+    if (*m_pos == '0') {
+        m_pos++;
+    } else {
+        while (m_pos < m_end && isDigit(*m_pos)) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*m_pos - '0');
+                digits++;
+            } else {
+                exponent++;
+                truncated = true;
+            }
+            m_pos++;
+        }
+    }
+
+    if (m_pos < m_end && *m_pos == '.') {
+        m_pos++;
+        if (m_pos >= m_end || !isDigit(*m_pos))
+            return setError(QStringLiteral("illegal number"));
+
+        while (m_pos < m_end && isDigit(*m_pos)) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*m_pos - '0');
+                exponent--;
+                if (mantissa)
+                    digits++;
+            } else {
+                truncated = true;
+            }
+            m_pos++;
+        }
+    }
+
+    if (m_pos < m_end && (*m_pos == 'e' || *m_pos == 'E')) {
+        m_pos++;
+
+        bool expNegative = false;
+        if (m_pos < m_end && (*m_pos == '+' || *m_pos == '-')) {
+            expNegative = *m_pos == '-';
+            m_pos++;
+        }
+
+        if (m_pos >= m_end || !isDigit(*m_pos))
+            return setError(QStringLiteral("illegal number"));
+
+        int exp = 0;
+        while (m_pos < m_end && isDigit(*m_pos)) {
+            if (exp < 100000)
+                exp = exp * 10 + (*m_pos - '0');
+            m_pos++;
+        }
+
+        exponent += expNegative ? -exp : exp;
+    }
+
+    double d;
+    if (!truncated
+            && mantissa <= (Q_UINT64_C(1) << 53)
+            && exponent >= -22 && exponent <= 22) {
+        // exact: both operands are representable, the result is correctly rounded
+        d = double(mantissa);
+        if (exponent < 0)
+            d /= PowersOf10[-exponent];
+        else
+            d *= PowersOf10[exponent];
+
+        if (negative)
+            d = -d;
+    } else {
+        bool ok;
+        d = QByteArray::fromRawData(start, int(m_pos - start)).toDouble(&ok);
+        if (!ok && !qIsInf(d) && d != 0.0) {
+            m_pos = start;
+            return setError(QStringLiteral("illegal number"));
+        }
+    }
+
+    value = d;
+    return true;
+}
+
+bool JsonReader::parseLiteral(const char* literal, int length)
+{
+    if (m_end - m_pos < length || std::memcmp(m_pos, literal, length) != 0)
+        return setError(QStringLiteral("illegal value"));
+
+    m_pos += length;
+    return true;
+}
+
+bool JsonReader::parseHex4(uint& ucs)
+{
+    if (m_end - m_pos < 4)
+        return setError(QStringLiteral("invalid escape sequence"));
+
+    ucs = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = *m_pos;
+        uint digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return setError(QStringLiteral("invalid escape sequence"));
+
+        ucs = (ucs << 4) | digit;
+        m_pos++;
+    }
+
+    return true;
+}
+
+bool JsonReader::reportProgress()
+{
+    if (m_end - m_pos > m_progressInterval)
+        m_nextProgress = m_pos + m_progressInterval;
+    else
+        m_nextProgress = m_end;
+
+    if (!m_progressFunc(m_pos - m_begin, m_nodeCount))
+        return setError(QStringLiteral("loading cancelled"));
+
+    return true;
+}
+
+void JsonReader::skipWhitespace()
+{
+    while (m_pos < m_end) {
+        char c = *m_pos;
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t')
+            break;
+        m_pos++;
+    }
+}
+
+bool JsonReader::setError(const QString& error)
+{
+    m_errorString = error;
+    m_errorOffset = m_pos - m_begin;
+    return false;
+}
@@ -0,0 +1,70 @@
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <functional>
+
+#include <QString>
+#include <QVariant>
+
+class JsonReader
+{
+    using This = JsonReader;
+
+public:
+    // called with the bytes parsed so far and the node count,
+    // returning false cancels the parsing
+    using ProgressFunc = std::function<bool(qint64, qint64)>;
+
+    JsonReader(const char* data, qint64 size);
+
+    void setProgressFunc(ProgressFunc func, qint64 interval = 1 << 22);
+
+    // parses the whole document straight into QVariantList/QVariantMap nodes
+    bool read(QVariant& value);
+
+    // same as read(), but the elements of a top-level array are split
+    // into chunks that are parsed on the global thread pool
+    bool readParallel(QVariant& value);
+
+    // error getters
+    const QString& errorString() const
+    { return m_errorString; }
+    qint64 errorOffset() const
+    { return m_errorOffset; }
+    int errorLine() const;
+
+    qint64 nodeCount() const
+    { return m_nodeCount; }
+
+private:
+    void start();
+    bool finish();
+    bool parseElements(QVariantList::iterator it, int count, const char* begin, const char* end);
+
+    bool parseValue(QVariant& value, int depth);
+    bool parseArray(QVariant& value, int depth);
+    bool parseObject(QVariant& value, int depth);
+    bool parseString(QString& str);
+    bool parseNumber(QVariant& value);
+    bool parseLiteral(const char* literal, int length);
+    bool parseHex4(uint& ucs);
+
+    bool reportProgress();
+    inline void skipWhitespace();
+    bool setError(const QString& error);
+
+    const char* m_begin;
+    const char* m_pos;
+    const char* m_end;
+
+    qint64 m_nodeCount;
+
+    ProgressFunc m_progressFunc;
+    qint64 m_progressInterval;
+    const char* m_nextProgress;
+
+    QString m_errorString;
+    qint64 m_errorOffset;
+};
+
+#endif // JSONREADER_H
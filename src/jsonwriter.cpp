@@ -0,0 +1,271 @@
+#include <cmath>
+
+#include <QIODevice>
+#include <QLocale>
+#include <QtNumeric>
+
+#include "jsonwriter.h"
+
+namespace {
+
+const int BufferSize = 1 << 20;
+
+// integral doubles up to 2^53 are printed without an exponent
+const double MaxExactDouble = 9007199254740992.0;
+
+const char HexDigits[] = "0123456789abcdef";
+
+} // namespace
+
+JsonWriter::JsonWriter(QIODevice* device, Format format) :
+    m_device(device),
+    m_format(format),
+    m_bytesWritten(0)
+{
+    m_buffer.reserve(BufferSize + 64);
+}
+
+bool JsonWriter::write(const QVariant& value)
+{
+    m_errorString.clear();
+
+    writeValue(value, 0);
+    if (m_format == Indented)
+        m_buffer.append('\n');
+
+    flush();
+    return m_errorString.isEmpty();
+}
+
+void JsonWriter::writeValue(const QVariant& value, int indent)
+{
+    if (!m_errorString.isEmpty())
+        return;
+
+    uint type = value.type();
+
+    switch (type) {
+    case QVariant::Invalid: {
+        writeRaw("null", 4);
+        break;
+    }
+    case QVariant::Bool: {
+        if (value.toBool())
+            writeRaw("true", 4);
+        else
+            writeRaw("false", 5);
+        break;
+    }
+    case QVariant::Int:
+    case QVariant::LongLong: {
+        qlonglong ll = value.toLongLong();
+        writeInteger(ll < 0 ? qulonglong(0) - qulonglong(ll) : qulonglong(ll), ll < 0);
+        break;
+    }
+    case QVariant::UInt:
+    case QVariant::ULongLong: {
+        writeInteger(value.toULongLong(), false);
+        break;
+    }
+    case QVariant::Double:
+    case QMetaType::Float: {
+        writeDouble(value.toDouble());
+        break;
+    }
+    case QVariant::String: {
+        writeString(*reinterpret_cast<const QString*>(value.constData()));
+        break;
+    }
+    case QVariant::List: {
+        const QVariantList& arr = *reinterpret_cast<const QVariantList*>(value.constData());
+        if (arr.isEmpty()) {
+            writeRaw("[]", 2);
+            break;
+        }
+
+        m_buffer.append('[');
+        auto it = arr.constBegin();
+        auto itEnd = arr.constEnd();
+        while (it != itEnd) {
+            writeIndent(indent + 1);
+            writeValue(*it, indent + 1);
+            it++;
+            if (it != itEnd)
+                m_buffer.append(',');
+        }
+        writeIndent(indent);
+        m_buffer.append(']');
+        break;
+    }
+    case QVariant::Map: {
+        const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(value.constData());
+        if (obj.isEmpty()) {
+            writeRaw("{}", 2);
+            break;
+        }
+
+        m_buffer.append('{');
+        auto it = obj.constBegin();
+        auto itEnd = obj.constEnd();
+        while (it != itEnd) {
+            writeIndent(indent + 1);
+            writeString(it.key());
+            if (m_format == Indented)
+                writeRaw(": ", 2);
+            else
+                m_buffer.append(':');
+            writeValue(it.value(), indent + 1);
+            it++;
+            if (it != itEnd)
+                m_buffer.append(',');
+        }
+        writeIndent(indent);
+        m_buffer.append('}');
+        break;
+    }
+    case QVariant::StringList: {
+        writeValue(value.toList(), indent);
+        break;
+    }
+    case QVariant::ByteArray: {
+        // binary values of CBOR and MessagePack documents
+        writeString(QString::fromLatin1(reinterpret_cast<const QByteArray*>(value.constData())->toBase64()));
+        break;
+    }
+    default: {
+        // char, date, time, url, uuid...
+        writeString(value.toString());
+        break;
+    }
+    }
+}
+
+void JsonWriter::writeString(const QString& str)
+{
+    m_buffer.append('"');
+
+    const QChar* it = str.constData();
+    const QChar* itEnd = it + str.size();
+
+    for (; it != itEnd; it++) {
+        ushort ch = it->unicode();
+
+        if (ch < 0x80) {
+            switch (ch) {
+            case '"':  writeRaw("\\\"", 2); break;
+            case '\\': writeRaw("\\\\", 2); break;
+            case '\b': writeRaw("\\b", 2);  break;
+            case '\f': writeRaw("\\f", 2);  break;
+            case '\n': writeRaw("\\n", 2);  break;
+            case '\r': writeRaw("\\r", 2);  break;
+            case '\t': writeRaw("\\t", 2);  break;
+            default:
+                if (ch < 0x20) {
+                    char esc[6] = { '\\', 'u', '0', '0', HexDigits[ch >> 4], HexDigits[ch & 0xf] };
+                    writeRaw(esc, 6);
+                } else {
+                    m_buffer.append(char(ch));
+                }
+                break;
+            }
+        } else if (ch < 0x800) {
+            m_buffer.append(char(0xc0 | (ch >> 6)));
+            m_buffer.append(char(0x80 | (ch & 0x3f)));
+        } else if (QChar::isHighSurrogate(ch) && it + 1 != itEnd && (it + 1)->isLowSurrogate()) {
+            uint ucs = QChar::surrogateToUcs4(ch, (it + 1)->unicode());
+            it++;
+            m_buffer.append(char(0xf0 | (ucs >> 18)));
+            m_buffer.append(char(0x80 | ((ucs >> 12) & 0x3f)));
+            m_buffer.append(char(0x80 | ((ucs >> 6) & 0x3f)));
+            m_buffer.append(char(0x80 | (ucs & 0x3f)));
+        } else if (QChar::isSurrogate(ch)) {
+            // lone surrogates are kept as escapes
+            char esc[6] = { '\\', 'u', HexDigits[ch >> 12], HexDigits[(ch >> 8) & 0xf], HexDigits[(ch >> 4) & 0xf], HexDigits[ch & 0xf] };
+            writeRaw(esc, 6);
+        } else {
+            m_buffer.append(char(0xe0 | (ch >> 12)));
+            m_buffer.append(char(0x80 | ((ch >> 6) & 0x3f)));
+            m_buffer.append(char(0x80 | (ch & 0x3f)));
+        }
+    }
+
+    writeRaw("\"", 1);
+}
+
+void JsonWriter::writeDouble(double d)
+{
+    // JSON has no representation for nan and infinity
+    if (!qIsFinite(d)) {
+        writeRaw("null", 4);
+        return;
+    }
+
+    if (d == std::floor(d) && std::fabs(d) < MaxExactDouble) {
+        if (d == 0.0 && std::signbit(d))
+            writeRaw("-0", 2);
+        else
+            writeInteger(qulonglong(std::fabs(d)), d < 0);
+        return;
+    }
+
+    QByteArray number = QByteArray::number(d, 'g', QLocale::FloatingPointShortest);
+    writeRaw(number.constData(), number.size());
+}
+
+void JsonWriter::writeInteger(qulonglong value, bool negative)
+{
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+
+    do {
+        *--p = char('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    if (negative)
+        *--p = '-';
+
+    writeRaw(p, int(end - p));
+}
+
+void JsonWriter::writeIndent(int indent)
+{
+    if (m_format == Compact)
+        return;
+
+    m_buffer.append('\n');
+    for (int i = 0; i < indent; i++)
+        m_buffer.append("    ", 4);
+}
+
+void JsonWriter::writeRaw(const char* str, int size)
+{
+    m_buffer.append(str, size);
+    if (m_buffer.size() >= BufferSize)
+        flush();
+}
+
+bool JsonWriter::flush()
+{
+    if (m_buffer.isEmpty())
+        return true;
+
+    qint64 size = m_buffer.size();
+    qint64 written = m_errorString.isEmpty() ? m_device->write(m_buffer.constData(), size) : -1;
+
+    // keep the reserved capacity
+    m_buffer.resize(0);
+
+    if (written != size) {
+        if (m_errorString.isEmpty())
+            m_errorString = m_device->errorString();
+        return false;
+    }
+
+    m_bytesWritten += written;
+    if (m_progressFunc)
+        m_progressFunc(m_bytesWritten);
+
+    return true;
+}
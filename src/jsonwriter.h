@@ -0,0 +1,59 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <functional>
+
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+class QIODevice;
+
+class JsonWriter
+{
+    using This = JsonWriter;
+
+public:
+    using ProgressFunc = std::function<void(qint64)>;
+
+    enum Format {
+        Indented,
+        Compact
+    };
+
+    explicit JsonWriter(QIODevice* device, Format format = Indented);
+
+    // called with the total byte count after each buffer flush
+    void setProgressFunc(const ProgressFunc& func)
+    { m_progressFunc = func; }
+
+    // serializes the value through a fixed size buffer
+    bool write(const QVariant& value);
+
+    qint64 bytesWritten() const
+    { return m_bytesWritten; }
+    const QString& errorString() const
+    { return m_errorString; }
+
+private:
+    void writeValue(const QVariant& value, int indent);
+    void writeString(const QString& str);
+    void writeDouble(double d);
+    void writeInteger(qulonglong value, bool negative);
+    inline void writeIndent(int indent);
+    inline void writeRaw(const char* str, int size);
+
+    bool flush();
+
+    QIODevice* m_device;
+    Format m_format;
+
+    QByteArray m_buffer;
+    qint64 m_bytesWritten;
+
+    ProgressFunc m_progressFunc;
+
+    QString m_errorString;
+};
+
+#endif // JSONWRITER_H
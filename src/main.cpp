@@ -4,11 +4,16 @@
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 
+#include "cli.h"
 #include "varianttreemodel.h"
 #include "varianttreewidget.h"
 
 int main(int argc, char *argv[])
 {
+    // batch commands run before any gui object exists
+    if (isCommandLine(argc, argv))
+        return runCommandLine(argc, argv);
+
     QApplication app(argc, argv);
 
     VariantTreeWidget jw;
@@ -0,0 +1,419 @@
+#include <climits>
+#include <cstring>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QtEndian>
+
+#include "msgpackreader.h"
+
+namespace {
+
+// same nesting limit as QJsonDocument
+const int MaxDepth = 1024;
+
+// extension type of the predefined timestamps
+const qint8 TimestampType = -1;
+
+// integers keep the smallest of int, longlong and ulonglong
+// that holds them, like the YAML core schema resolution
+QVariant unsignedValue(quint64 n)
+{
+    if (n <= quint64(INT_MAX))
+        return int(n);
+    if (n <= quint64(LLONG_MAX))
+        return qlonglong(n);
+    return qulonglong(n);
+}
+
+QVariant signedValue(qint64 n)
+{
+    if (n >= INT_MIN && n <= INT_MAX)
+        return int(n);
+    return qlonglong(n);
+}
+
+} // namespace
+
+MsgPackReader::MsgPackReader(const char* data, qint64 size) :
+    m_begin(data),
+    m_pos(data),
+    m_end(data + size),
+    m_nodeCount(0),
+    m_documentCount(0),
+    m_progressInterval(0),
+    m_nextProgress(data + size),
+    m_errorOffset(-1)
+{ }
+
+void MsgPackReader::setProgressFunc(ProgressFunc func, qint64 interval)
+{
+    m_progressFunc = func;
+    m_progressInterval = interval;
+}
+
+bool MsgPackReader::read(QVariant& value)
+{
+    m_pos = m_begin;
+    m_nodeCount = 0;
+    m_documentCount = 0;
+    m_nextProgress = m_progressFunc ? m_begin : m_end;
+    m_errorString.clear();
+    m_errorOffset = -1;
+
+    QVariantList documents;
+    do {
+        documents.append(QVariant());
+        if (!readValue(documents.last(), 0))
+            return false;
+    } while (m_pos < m_end);
+
+    m_documentCount = documents.size();
+    if (m_documentCount == 1)
+        value.swap(documents.first());
+    else
+        value = documents;
+
+    return true;
+}
+
+bool MsgPackReader::readValue(QVariant& value, int depth)
+{
+    if (!ensure(1))
+        return false;
+
+    m_nodeCount++;
+
+    if (m_pos >= m_nextProgress && !reportProgress())
+        return false;
+
+    quint8 c = quint8(*m_pos++);
+
+    // fixed size formats keep the value or the length in the type byte
+    if (c <= 0x7f) {
+        value = int(c);
+        return true;
+    }
+    if (c >= 0xe0) {
+        value = int(qint8(c));
+        return true;
+    }
+    if ((c & 0xf0) == 0x80)
+        return readMap(value, c & 0x0f, depth + 1);
+    if ((c & 0xf0) == 0x90)
+        return readArray(value, c & 0x0f, depth + 1);
+    if ((c & 0xe0) == 0xa0) {
+        QString str;
+        if (!readString(c & 0x1f, str))
+            return false;
+        value = str;
+        return true;
+    }
+
+    quint32 length;
+
+    switch (c) {
+    case 0xc0:
+        value = QVariant();
+        return true;
+    case 0xc2:
+        value = false;
+        return true;
+    case 0xc3:
+        value = true;
+        return true;
+    case 0xc4:
+    case 0xc5:
+    case 0xc6: {
+        if (!readLength(1 << (c - 0xc4), length) || !ensure(length))
+            return false;
+        value = QByteArray(m_pos, int(length));
+        m_pos += length;
+        return true;
+    }
+    case 0xc7:
+    case 0xc8:
+    case 0xc9: {
+        if (!readLength(1 << (c - 0xc7), length))
+            return false;
+        return readExtension(value, length);
+    }
+    case 0xca: {
+        if (!ensure(4))
+            return false;
+        quint32 bits = qFromBigEndian<quint32>(m_pos);
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        value = f;
+        m_pos += 4;
+        return true;
+    }
+    case 0xcb: {
+        if (!ensure(8))
+            return false;
+        quint64 bits = qFromBigEndian<quint64>(m_pos);
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        value = d;
+        m_pos += 8;
+        return true;
+    }
+    case 0xcc: {
+        if (!ensure(1))
+            return false;
+        value = int(quint8(*m_pos));
+        m_pos += 1;
+        return true;
+    }
+    case 0xcd: {
+        if (!ensure(2))
+            return false;
+        value = int(qFromBigEndian<quint16>(m_pos));
+        m_pos += 2;
+        return true;
+    }
+    case 0xce: {
+        if (!ensure(4))
+            return false;
+        value = unsignedValue(qFromBigEndian<quint32>(m_pos));
+        m_pos += 4;
+        return true;
+    }
+    case 0xcf: {
+        if (!ensure(8))
+            return false;
+        value = unsignedValue(qFromBigEndian<quint64>(m_pos));
+        m_pos += 8;
+        return true;
+    }
+    case 0xd0: {
+        if (!ensure(1))
+            return false;
+        value = int(qint8(*m_pos));
+        m_pos += 1;
+        return true;
+    }
+    case 0xd1: {
+        if (!ensure(2))
+            return false;
+        value = int(qFromBigEndian<qint16>(m_pos));
+        m_pos += 2;
+        return true;
+    }
+    case 0xd2: {
+        if (!ensure(4))
+            return false;
+        value = int(qFromBigEndian<qint32>(m_pos));
+        m_pos += 4;
+        return true;
+    }
+    case 0xd3: {
+        if (!ensure(8))
+            return false;
+        value = signedValue(qFromBigEndian<qint64>(m_pos));
+        m_pos += 8;
+        return true;
+    }
+    case 0xd4:
+    case 0xd5:
+    case 0xd6:
+    case 0xd7:
+    case 0xd8:
+        return readExtension(value, 1 << (c - 0xd4));
+    case 0xd9:
+    case 0xda:
+    case 0xdb: {
+        QString str;
+        if (!readLength(1 << (c - 0xd9), length) || !readString(length, str))
+            return false;
+        value = str;
+        return true;
+    }
+    case 0xdc:
+    case 0xdd: {
+        if (!readLength(2 << (c - 0xdc), length))
+            return false;
+        return readArray(value, length, depth + 1);
+    }
+    case 0xde:
+    case 0xdf: {
+        if (!readLength(2 << (c - 0xde), length))
+            return false;
+        return readMap(value, length, depth + 1);
+    }
+    default:
+        m_pos--;
+        return setError(QStringLiteral("invalid type byte"));
+    }
+}
+
+bool MsgPackReader::readArray(QVariant& value, quint32 count, int depth)
+{
+    if (depth > MaxDepth)
+        return setError(QStringLiteral("too deeply nested document"));
+
+    value = QVariantList();
+    QVariantList& arr = *reinterpret_cast<QVariantList*>(value.data());
+
+    // every element takes at least one byte, a bogus count can not over-allocate
+    arr.reserve(int(qMin<qint64>(count, m_end - m_pos)));
+
+    for (quint32 i = 0; i < count; i++) {
+        arr.append(QVariant());
+        if (!readValue(arr.last(), depth))
+            return false;
+    }
+
+    return true;
+}
+
+bool MsgPackReader::readMap(QVariant& value, quint32 count, int depth)
+{
+    if (depth > MaxDepth)
+        return setError(QStringLiteral("too deeply nested document"));
+
+    value = QVariantMap();
+    QVariantMap& obj = *reinterpret_cast<QVariantMap*>(value.data());
+
+    for (quint32 i = 0; i < count; i++) {
+        QString key;
+        if (!readKey(key))
+            return false;
+
+        // duplicate keys: the last value wins like in QJsonObject
+        if (!readValue(obj[key], depth))
+            return false;
+    }
+
+    return true;
+}
+
+bool MsgPackReader::readKey(QString& key)
+{
+    if (!ensure(1))
+        return false;
+
+    quint8 c = quint8(*m_pos);
+
+    // integer keys are kept as their decimal text
+    if (c <= 0x7f || c >= 0xe0 || (c >= 0xcc && c <= 0xd3)) {
+        QVariant number;
+        if (!readValue(number, 0))
+            return false;
+        m_nodeCount--;
+        key = number.toString();
+        return true;
+    }
+
+    quint32 length;
+    m_pos++;
+
+    if ((c & 0xe0) == 0xa0)
+        return readString(c & 0x1f, key);
+    if (c >= 0xd9 && c <= 0xdb)
+        return readLength(1 << (c - 0xd9), length) && readString(length, key);
+
+    m_pos--;
+    return setError(QStringLiteral("map key must be a string or an integer"));
+}
+
+bool MsgPackReader::readString(quint32 length, QString& str)
+{
+    if (!ensure(length))
+        return false;
+
+    str = QString::fromUtf8(m_pos, int(length));
+    m_pos += length;
+    return true;
+}
+
+bool MsgPackReader::readExtension(QVariant& value, quint32 size)
+{
+    if (!ensure(qint64(size) + 1))
+        return false;
+
+    qint8 type = qint8(*m_pos++);
+    const char* data = m_pos;
+    m_pos += size;
+
+    if (type == TimestampType) {
+        qint64 seconds;
+        quint32 nanoseconds;
+
+        switch (size) {
+        case 4:
+            seconds = qFromBigEndian<quint32>(data);
+            nanoseconds = 0;
+            break;
+        case 8: {
+            // 30 bits of nanoseconds above 34 bits of seconds
+            quint64 bits = qFromBigEndian<quint64>(data);
+            seconds = qint64(bits & 0x3ffffffffull);
+            nanoseconds = quint32(bits >> 34);
+            break;
+        }
+        case 12:
+            nanoseconds = qFromBigEndian<quint32>(data);
+            seconds = qFromBigEndian<qint64>(data + 4);
+            break;
+        default:
+            m_pos = data;
+            return setError(QStringLiteral("invalid timestamp size"));
+        }
+
+        value = QDateTime::fromMSecsSinceEpoch(seconds * 1000 + nanoseconds / 1000000, Qt::UTC);
+        return true;
+    }
+
+    // application types keep their payload
+    value = QByteArray(data, int(size));
+    return true;
+}
+
+bool MsgPackReader::readLength(int bytes, quint32& length)
+{
+    if (!ensure(bytes))
+        return false;
+
+    switch (bytes) {
+    case 1:
+        length = quint8(*m_pos);
+        break;
+    case 2:
+        length = qFromBigEndian<quint16>(m_pos);
+        break;
+    default:
+        length = qFromBigEndian<quint32>(m_pos);
+        break;
+    }
+
+    m_pos += bytes;
+    return true;
+}
+
+bool MsgPackReader::ensure(qint64 bytes)
+{
+    if (m_end - m_pos < bytes)
+        return setError(QStringLiteral("unexpected end of document"));
+    return true;
+}
+
+bool MsgPackReader::reportProgress()
+{
+    if (m_end - m_pos > m_progressInterval)
+        m_nextProgress = m_pos + m_progressInterval;
+    else
+        m_nextProgress = m_end;
+
+    if (!m_progressFunc(m_pos - m_begin, m_nodeCount))
+        return setError(QStringLiteral("loading cancelled"));
+
+    return true;
+}
+
+bool MsgPackReader::setError(const QString& error)
+{
+    m_errorString = error;
+    m_errorOffset = m_pos - m_begin;
+    return false;
+}
@@ -0,0 +1,66 @@
+#ifndef MSGPACKREADER_H
+#define MSGPACKREADER_H
+
+#include <functional>
+
+#include <QString>
+#include <QVariant>
+
+class MsgPackReader
+{
+    using This = MsgPackReader;
+
+public:
+    // called with the bytes parsed so far and the node count,
+    // returning false cancels the parsing
+    using ProgressFunc = std::function<bool(qint64, qint64)>;
+
+    MsgPackReader(const char* data, qint64 size);
+
+    void setProgressFunc(ProgressFunc func, qint64 interval = 1 << 22);
+
+    // decodes the objects straight into QVariantList/QVariantMap nodes,
+    // a stream of several top-level objects is read as an array of them
+    bool read(QVariant& value);
+
+    int documentCount() const
+    { return m_documentCount; }
+
+    // error getters
+    const QString& errorString() const
+    { return m_errorString; }
+    qint64 errorOffset() const
+    { return m_errorOffset; }
+
+    qint64 nodeCount() const
+    { return m_nodeCount; }
+
+private:
+    bool readValue(QVariant& value, int depth);
+    bool readArray(QVariant& value, quint32 count, int depth);
+    bool readMap(QVariant& value, quint32 count, int depth);
+    bool readKey(QString& key);
+    bool readString(quint32 length, QString& str);
+    bool readExtension(QVariant& value, quint32 size);
+    bool readLength(int bytes, quint32& length);
+    inline bool ensure(qint64 bytes);
+
+    bool reportProgress();
+    bool setError(const QString& error);
+
+    const char* m_begin;
+    const char* m_pos;
+    const char* m_end;
+
+    qint64 m_nodeCount;
+    int m_documentCount;
+
+    ProgressFunc m_progressFunc;
+    qint64 m_progressInterval;
+    const char* m_nextProgress;
+
+    QString m_errorString;
+    qint64 m_errorOffset;
+};
+
+#endif // MSGPACKREADER_H
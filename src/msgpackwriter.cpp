@@ -0,0 +1,245 @@
+#include <cstring>
+
+#include <QIODevice>
+#include <QUuid>
+#include <QtEndian>
+
+#include "msgpackwriter.h"
+
+namespace {
+
+const int BufferSize = 1 << 20;
+
+// extension type of the predefined timestamps
+const quint8 TimestampType = 0xff;
+
+} // namespace
+
+MsgPackWriter::MsgPackWriter(QIODevice* device) :
+    m_device(device),
+    m_bytesWritten(0)
+{
+    m_buffer.reserve(BufferSize + 64);
+}
+
+template<typename T>
+void MsgPackWriter::writeBigEndian(quint8 type, T value)
+{
+    char bytes[1 + sizeof(T)];
+    bytes[0] = char(type);
+    qToBigEndian<T>(value, bytes + 1);
+    m_buffer.append(bytes, sizeof(bytes));
+}
+
+bool MsgPackWriter::write(const QVariant& value, bool multiDocument)
+{
+    m_errorString.clear();
+
+    if (multiDocument && value.type() == QVariant::List) {
+        for (const QVariant& document : *reinterpret_cast<const QVariantList*>(value.constData()))
+            writeValue(document);
+    } else {
+        writeValue(value);
+    }
+
+    flush();
+    return m_errorString.isEmpty();
+}
+
+void MsgPackWriter::writeValue(const QVariant& value)
+{
+    if (!m_errorString.isEmpty())
+        return;
+
+    if (m_buffer.size() >= BufferSize)
+        flush();
+
+    uint type = value.type();
+
+    switch (type) {
+    case QVariant::Invalid: {
+        m_buffer.append(char(0xc0));
+        break;
+    }
+    case QVariant::Bool: {
+        m_buffer.append(char(value.toBool() ? 0xc3 : 0xc2));
+        break;
+    }
+    case QVariant::Int:
+    case QVariant::LongLong: {
+        writeSigned(value.toLongLong());
+        break;
+    }
+    case QVariant::UInt:
+    case QVariant::ULongLong: {
+        writeUnsigned(value.toULongLong());
+        break;
+    }
+    case QVariant::Double: {
+        double d = value.toDouble();
+        quint64 bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        writeBigEndian<quint64>(0xcb, bits);
+        break;
+    }
+    case QMetaType::Float: {
+        float f = value.toFloat();
+        quint32 bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        writeBigEndian<quint32>(0xca, bits);
+        break;
+    }
+    case QVariant::String: {
+        writeString(*reinterpret_cast<const QString*>(value.constData()));
+        break;
+    }
+    case QVariant::ByteArray: {
+        writeBytes(*reinterpret_cast<const QByteArray*>(value.constData()));
+        break;
+    }
+    case QVariant::List: {
+        const QVariantList& arr = *reinterpret_cast<const QVariantList*>(value.constData());
+        writeHeader(quint32(arr.size()), 0x90, 16, 0, 0xdc);
+        for (const QVariant& item : arr)
+            writeValue(item);
+        break;
+    }
+    case QVariant::Map: {
+        const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(value.constData());
+        writeHeader(quint32(obj.size()), 0x80, 16, 0, 0xde);
+        for (auto it = obj.constBegin(); it != obj.constEnd(); it++) {
+            writeString(it.key());
+            writeValue(it.value());
+        }
+        break;
+    }
+    case QVariant::StringList: {
+        const QStringList& list = *reinterpret_cast<const QStringList*>(value.constData());
+        writeHeader(quint32(list.size()), 0x90, 16, 0, 0xdc);
+        for (const QString& str : list)
+            writeString(str);
+        break;
+    }
+    case QVariant::DateTime: {
+        writeTimestamp(value.toDateTime());
+        break;
+    }
+    case QVariant::Uuid: {
+        writeBytes(value.toUuid().toRfc4122());
+        break;
+    }
+    default: {
+        // char, date, time, url...
+        writeString(value.toString());
+        break;
+    }
+    }
+}
+
+void MsgPackWriter::writeString(const QString& str)
+{
+    QByteArray utf8 = str.toUtf8();
+    writeHeader(quint32(utf8.size()), 0xa0, 32, 0xd9, 0xda);
+    m_buffer.append(utf8);
+}
+
+void MsgPackWriter::writeBytes(const QByteArray& bytes)
+{
+    writeHeader(quint32(bytes.size()), 0, 0, 0xc4, 0xc5);
+    m_buffer.append(bytes);
+}
+
+void MsgPackWriter::writeUnsigned(quint64 value)
+{
+    if (value <= 0x7f)
+        m_buffer.append(char(value));
+    else if (value <= 0xff)
+        writeBigEndian<quint8>(0xcc, quint8(value));
+    else if (value <= 0xffff)
+        writeBigEndian<quint16>(0xcd, quint16(value));
+    else if (value <= 0xffffffff)
+        writeBigEndian<quint32>(0xce, quint32(value));
+    else
+        writeBigEndian<quint64>(0xcf, value);
+}
+
+void MsgPackWriter::writeSigned(qint64 value)
+{
+    if (value >= 0)
+        writeUnsigned(quint64(value));
+    else if (value >= -32)
+        m_buffer.append(char(value));
+    else if (value >= -128)
+        writeBigEndian<qint8>(0xd0, qint8(value));
+    else if (value >= -32768)
+        writeBigEndian<qint16>(0xd1, qint16(value));
+    else if (value >= -2147483647 - 1)
+        writeBigEndian<qint32>(0xd2, qint32(value));
+    else
+        writeBigEndian<qint64>(0xd3, value);
+}
+
+void MsgPackWriter::writeHeader(quint32 length, quint8 fixed, quint32 fixedLimit, quint8 type8, quint8 type16)
+{
+    // the 32 bit variant follows the 16 bit one
+    if (length < fixedLimit)
+        m_buffer.append(char(fixed | length));
+    else if (type8 && length <= 0xff)
+        writeBigEndian<quint8>(type8, quint8(length));
+    else if (length <= 0xffff)
+        writeBigEndian<quint16>(type16, quint16(length));
+    else
+        writeBigEndian<quint32>(type16 + 1, length);
+}
+
+void MsgPackWriter::writeTimestamp(const QDateTime& dateTime)
+{
+    qint64 msecs = dateTime.toMSecsSinceEpoch();
+    qint64 seconds = msecs / 1000;
+    qint64 millis = msecs % 1000;
+    if (millis < 0) {
+        seconds--;
+        millis += 1000;
+    }
+    quint32 nanoseconds = quint32(millis * 1000000);
+
+    // the smallest of the 32, 64 and 96 bit formats
+    if (nanoseconds == 0 && seconds >= 0 && seconds <= 0xffffffffll) {
+        m_buffer.append(char(0xd6));
+        writeBigEndian<quint32>(TimestampType, quint32(seconds));
+    } else if (seconds >= 0 && seconds < (1ll << 34)) {
+        m_buffer.append(char(0xd7));
+        writeBigEndian<quint64>(TimestampType, (quint64(nanoseconds) << 34) | quint64(seconds));
+    } else {
+        m_buffer.append(char(0xc7));
+        m_buffer.append(char(12));
+        writeBigEndian<quint32>(TimestampType, nanoseconds);
+        char bytes[sizeof(qint64)];
+        qToBigEndian<qint64>(seconds, bytes);
+        m_buffer.append(bytes, sizeof(bytes));
+    }
+}
+
+bool MsgPackWriter::flush()
+{
+    if (m_buffer.isEmpty())
+        return true;
+
+    qint64 size = m_buffer.size();
+    qint64 written = m_errorString.isEmpty() ? m_device->write(m_buffer.constData(), size) : -1;
+
+    // keep the reserved capacity
+    m_buffer.resize(0);
+
+    if (written != size) {
+        if (m_errorString.isEmpty())
+            m_errorString = m_device->errorString();
+        return false;
+    }
+
+    m_bytesWritten += written;
+    if (m_progressFunc)
+        m_progressFunc(m_bytesWritten);
+
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef MSGPACKWRITER_H
+#define MSGPACKWRITER_H
+
+#include <functional>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#include <QVariant>
+
+class QIODevice;
+
+class MsgPackWriter
+{
+    using This = MsgPackWriter;
+
+public:
+    using ProgressFunc = std::function<void(qint64)>;
+
+    explicit MsgPackWriter(QIODevice* device);
+
+    // called with the total byte count after each buffer flush
+    void setProgressFunc(const ProgressFunc& func)
+    { m_progressFunc = func; }
+
+    // encodes the value through a fixed size buffer, with multiDocument
+    // the elements of an array are written as a stream of top-level objects
+    bool write(const QVariant& value, bool multiDocument = false);
+
+    qint64 bytesWritten() const
+    { return m_bytesWritten; }
+    const QString& errorString() const
+    { return m_errorString; }
+
+private:
+    void writeValue(const QVariant& value);
+    void writeString(const QString& str);
+    void writeBytes(const QByteArray& bytes);
+    void writeUnsigned(quint64 value);
+    void writeSigned(qint64 value);
+    void writeHeader(quint32 length, quint8 fixed, quint32 fixedLimit, quint8 type8, quint8 type16);
+    void writeTimestamp(const QDateTime& dateTime);
+    template<typename T>
+    inline void writeBigEndian(quint8 type, T value);
+
+    bool flush();
+
+    QIODevice* m_device;
+
+    QByteArray m_buffer;
+    qint64 m_bytesWritten;
+
+    ProgressFunc m_progressFunc;
+
+    QString m_errorString;
+};
+
+#endif // MSGPACKWRITER_H
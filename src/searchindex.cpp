@@ -0,0 +1,1032 @@
+#include <algorithm>
+#include <functional>
+
+#include <QHash>
+#include <QRegularExpression>
+#include <QtConcurrent>
+
+#include "searchindex.h"
+#include "varianttreemodel.h"
+
+struct SearchIndex::Segment
+{
+    // sorted, lower case keys and stringified scalar values
+    QStringList terms;
+    // node id << 1, plus 1 for key hits
+    QVector<QVector<int>> postings;
+
+    // pre-order node table, the bucket rows have no parent (-1)
+    // and a row relative to the first one of the bucket
+    QVector<int> nodeParent;
+    QVector<int> nodeRow;
+};
+
+struct SearchIndex::Range
+{
+    const QVariant* parent;
+    int first;
+    int count;
+    bool shallow;
+    // map rows are reached through an iterator
+    QVariantMap::const_iterator it;
+};
+
+namespace {
+
+// edits are collected for a moment before the worker is started
+const int BuildDelay = 300;
+
+// nodes per bucket, childs above twice that many are split into buckets of their own
+const int BucketSize = 4096;
+const int LargeSubtree = 2 * BucketSize;
+
+QString termText(const QVariant& value)
+{
+    if (value.type() == QVariant::Invalid)
+        return QStringLiteral("null");
+    return value.toString().toLower();
+}
+
+class Matcher
+{
+public:
+    Matcher(const QString& text, SearchIndex::MatchMode mode) :
+        m_mode(mode),
+        m_needle(text.toLower())
+    {
+        if (mode == SearchIndex::RegularExpression) {
+            m_regex.setPattern(text);
+            m_regex.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+            m_regex.optimize();
+        }
+    }
+
+    bool isValid() const
+    { return m_mode != SearchIndex::RegularExpression || m_regex.isValid(); }
+
+    SearchIndex::MatchMode mode() const
+    { return m_mode; }
+    const QString& needle() const
+    { return m_needle; }
+
+    // term is lower case already
+    bool matches(const QString& term) const
+    {
+        switch (m_mode) {
+        case SearchIndex::Substring:
+            return term.contains(m_needle);
+        case SearchIndex::Prefix:
+            return term.startsWith(m_needle);
+        case SearchIndex::RegularExpression:
+            return m_regex.match(term).hasMatch();
+        }
+        return false;
+    }
+
+private:
+    SearchIndex::MatchMode m_mode;
+    QString m_needle;
+    QRegularExpression m_regex;
+};
+
+class SegmentBuilder
+{
+public:
+    SearchIndex::Segment* build(const SearchIndex::Range& range)
+    {
+        m_segment = new SearchIndex::Segment;
+
+        // a shallow bucket has the node only, its childs are in other buckets
+        bool recursive = !range.shallow;
+        if (range.parent->type() == QVariant::List) {
+            const QVariantList& arr = *reinterpret_cast<const QVariantList*>(range.parent->constData());
+            for (int i = 0; i < range.count; i++)
+                add(arr.at(range.first + i), nullptr, -1, i, recursive);
+        } else {
+            auto it = range.it;
+            for (int i = 0; i < range.count; i++, it++)
+                add(it.value(), &it.key(), -1, i, recursive);
+        }
+
+        m_segment->terms = m_postings.keys();
+        std::sort(m_segment->terms.begin(), m_segment->terms.end());
+        m_segment->postings.reserve(m_segment->terms.count());
+        for (const QString& term : m_segment->terms)
+            m_segment->postings.append(m_postings.value(term));
+
+        return m_segment;
+    }
+
+private:
+    void add(const QVariant& value, const QString* key, int parent, int row, bool recursive)
+    {
+        int id = m_segment->nodeParent.count();
+        m_segment->nodeParent.append(parent);
+        m_segment->nodeRow.append(row);
+
+        if (key)
+            m_postings[key->toLower()].append(id << 1 | 1);
+
+        if (value.type() == QVariant::List) {
+            if (!recursive)
+                return;
+            const QVariantList& arr = *reinterpret_cast<const QVariantList*>(value.constData());
+            for (int i = 0; i < arr.count(); i++)
+                add(arr.at(i), nullptr, id, i, true);
+        } else if (value.type() == QVariant::Map) {
+            if (!recursive)
+                return;
+            const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(value.constData());
+            int childRow = 0;
+            for (auto it = obj.constBegin(); it != obj.constEnd(); it++)
+                add(it.value(), &it.key(), id, childRow++, true);
+        } else {
+            m_postings[termText(value)].append(id << 1);
+        }
+    }
+
+    SearchIndex::Segment* m_segment;
+    QHash<QString, QVector<int>> m_postings;
+};
+
+int childCount(const QVariant& value)
+{
+    if (value.type() == QVariant::List)
+        return reinterpret_cast<const QVariantList*>(value.constData())->count();
+    if (value.type() == QVariant::Map)
+        return reinterpret_cast<const QVariantMap*>(value.constData())->count();
+    return -1;
+}
+
+// node count of a subtree, counting stops once it is above limit
+int countNodes(const QVariant& value, int limit)
+{
+    int count = 1;
+
+    if (value.type() == QVariant::List) {
+        for (const QVariant& child : *reinterpret_cast<const QVariantList*>(value.constData())) {
+            count += countNodes(child, limit - count);
+            if (count > limit)
+                break;
+        }
+    } else if (value.type() == QVariant::Map) {
+        for (const QVariant& child : *reinterpret_cast<const QVariantMap*>(value.constData())) {
+            count += countNodes(child, limit - count);
+            if (count > limit)
+                break;
+        }
+    }
+
+    return count;
+}
+
+bool startsWith(const QVector<int>& path, const QVector<int>& prefix)
+{
+    return path.count() >= prefix.count() && std::equal(prefix.begin(), prefix.end(), path.begin());
+}
+
+// whether path comes before parentPath + row in document order
+bool precedes(const QVector<int>& path, const QVector<int>& parentPath, int row)
+{
+    int depth = parentPath.count();
+    int count = qMin(path.count(), depth + 1);
+    for (int i = 0; i < count; i++) {
+        int other = i < depth ? parentPath[i] : row;
+        if (path[i] != other)
+            return path[i] < other;
+    }
+    return path.count() < depth + 1;
+}
+
+// node ids of a clean segment, sorted into document order
+QVector<int> matchSegment(const SearchIndex::Segment& segment, const Matcher& matcher, int fields)
+{
+    QVector<int> ids;
+    auto collect = [&ids, &segment, fields](int term) {
+        for (int posting : segment.postings.at(term)) {
+            bool isKey = posting & 1;
+            if (fields & (isKey ? SearchIndex::Keys : SearchIndex::Values))
+                ids.append(posting >> 1);
+        }
+    };
+
+    if (matcher.mode() == SearchIndex::Prefix) {
+        // the matching terms are one range of the sorted dictionary
+        auto it = std::lower_bound(segment.terms.begin(), segment.terms.end(), matcher.needle());
+        for (; it != segment.terms.end() && it->startsWith(matcher.needle()); it++)
+            collect(it - segment.terms.begin());
+    } else {
+        for (int i = 0; i < segment.terms.count(); i++) {
+            if (matcher.matches(segment.terms.at(i)))
+                collect(i);
+        }
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+// direct search of values which are not indexed (yet)
+void walk(const QVariant& value, const QString* key, QVector<int>& path, const Matcher& matcher,
+          int fields, int limit, QList<QVector<int>>& hits, bool recursive = true)
+{
+    if (hits.count() >= limit)
+        return;
+
+    bool isContainer = value.type() == QVariant::List || value.type() == QVariant::Map;
+    bool hit = false;
+    if (key && (fields & SearchIndex::Keys))
+        hit = matcher.matches(key->toLower());
+    if (!hit && !isContainer && (fields & SearchIndex::Values))
+        hit = matcher.matches(termText(value));
+    if (hit)
+        hits.append(path);
+
+    if (!recursive)
+        return;
+
+    if (value.type() == QVariant::List) {
+        const QVariantList& arr = *reinterpret_cast<const QVariantList*>(value.constData());
+        for (int i = 0; i < arr.count(); i++) {
+            path.append(i);
+            walk(arr.at(i), nullptr, path, matcher, fields, limit, hits);
+            path.removeLast();
+        }
+    } else if (value.type() == QVariant::Map) {
+        const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(value.constData());
+        int row = 0;
+        for (auto it = obj.constBegin(); it != obj.constEnd(); it++) {
+            path.append(row++);
+            walk(it.value(), &it.key(), path, matcher, fields, limit, hits);
+            path.removeLast();
+        }
+    }
+}
+
+} // namespace
+
+SearchIndex::SearchIndex(VariantTreeModel* model, QObject* parent) :
+    QObject(parent),
+    m_model(model),
+    m_nextId(1),
+    m_fullRebuild(true),
+    m_building(false),
+    m_buildingFull(false)
+{
+    m_buildTimer.setSingleShot(true);
+    m_buildTimer.setInterval(BuildDelay);
+
+    connect(&m_buildTimer, SIGNAL(timeout()), SLOT(startBuild()));
+    connect(&m_buildWatcher, SIGNAL(finished()), SLOT(buildFinished()));
+
+    connect(model, SIGNAL(rowsInserted(const QModelIndex&, int, int)), SLOT(rowsInserted(const QModelIndex&, int, int)));
+    connect(model, SIGNAL(rowsRemoved(const QModelIndex&, int, int)), SLOT(rowsRemoved(const QModelIndex&, int, int)));
+    connect(model, SIGNAL(rowsAboutToBeMoved(const QModelIndex&, int, int, const QModelIndex&, int)),
+            SLOT(rowsAboutToBeMoved(const QModelIndex&, int, int, const QModelIndex&, int)));
+    connect(model, SIGNAL(rowsMoved(const QModelIndex&, int, int, const QModelIndex&, int)), SLOT(rowsMoved()));
+    connect(model, SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)), SLOT(dataChanged(const QModelIndex&, const QModelIndex&)));
+    connect(model, SIGNAL(layoutChanged()), SLOT(rebuild()));
+    connect(model, SIGNAL(modelReset()), SLOT(rebuild()));
+
+    scheduleBuild();
+}
+
+SearchIndex::~SearchIndex()
+{
+    m_buildWatcher.waitForFinished();
+}
+
+bool SearchIndex::isReady() const
+{
+    if (m_fullRebuild || (m_building && m_buildingFull))
+        return false;
+
+    for (const Slot& slot : m_slots) {
+        if (slot.dirty)
+            return false;
+    }
+
+    return true;
+}
+
+QList<QVector<int>> SearchIndex::search(const QString& text, MatchMode mode, Field fields, int limit) const
+{
+    QList<QVector<int>> hits;
+
+    Matcher matcher(text, mode);
+    if (text.isEmpty() || !matcher.isValid())
+        return hits;
+
+    const QVariant& root = m_model->variantTree();
+
+    // until a full build is done the whole tree is searched directly
+    if (m_fullRebuild || (m_building && m_buildingFull)) {
+        QVector<int> path;
+        walk(root, nullptr, path, matcher, fields, limit, hits);
+        return hits;
+    }
+
+    QVector<int> cleanSlots;
+    for (int i = 0; i < m_slots.count(); i++) {
+        if (!m_slots[i].dirty)
+            cleanSlots.append(i);
+    }
+
+    std::function<QVector<int>(int)> match = [this, &matcher, fields](int slot) {
+        return matchSegment(*m_slots[slot].segment, matcher, fields);
+    };
+    QVector<QVector<int>> matches = QtConcurrent::blockingMapped<QVector<QVector<int>>>(cleanSlots, match);
+
+    // the buckets are in document order, and so are the hits
+    int clean = 0;
+    for (int i = 0; i < m_slots.count() && hits.count() < limit; i++) {
+        const Slot& slot = m_slots[i];
+        const Bucket& bucket = slot.bucket;
+        QVector<int> path = bucket.parentPath;
+        int depth = path.count();
+
+        if (!slot.dirty) {
+            const Segment& segment = *slot.segment;
+            for (int id : matches.at(clean)) {
+                if (hits.count() >= limit)
+                    break;
+
+                QVector<int> nodePath = path;
+                int node = id;
+                for (; segment.nodeParent.at(node) >= 0; node = segment.nodeParent.at(node))
+                    nodePath.insert(depth, segment.nodeRow.at(node));
+                nodePath.insert(depth, bucket.first + segment.nodeRow.at(node));
+                hits.append(nodePath);
+            }
+            clean++;
+            continue;
+        }
+
+        const QVariant* parent = valueAt(root, bucket.parentPath);
+        if (!parent)
+            continue;
+
+        path.append(bucket.first);
+        if (parent->type() == QVariant::List) {
+            const QVariantList& arr = *reinterpret_cast<const QVariantList*>(parent->constData());
+            int last = qMin(bucket.first + bucket.count, arr.count());
+            for (int row = bucket.first; row < last; row++) {
+                path.last() = row;
+                walk(arr.at(row), nullptr, path, matcher, fields, limit, hits, !bucket.shallow);
+            }
+        } else if (parent->type() == QVariant::Map) {
+            const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(parent->constData());
+            int last = qMin(bucket.first + bucket.count, obj.count());
+            if (bucket.first >= last)
+                continue;
+            auto it = obj.constBegin() + bucket.first;
+            for (int row = bucket.first; row < last; row++, it++) {
+                path.last() = row;
+                walk(it.value(), &it.key(), path, matcher, fields, limit, hits, !bucket.shallow);
+            }
+        }
+    }
+
+    return hits;
+}
+
+// model changes
+// @@@@@@@@@@@@@
+
+void SearchIndex::rowsInserted(const QModelIndex& parent, int first, int last)
+{
+    // expanding a node creates rows but changes no data
+    if (m_model->isFetching())
+        return;
+
+    Edit edit;
+    edit.type = Edit::Insert;
+    edit.parentPath = m_model->path(parent);
+    edit.row = first;
+    edit.count = last - first + 1;
+    applyEdit(edit);
+}
+
+void SearchIndex::rowsRemoved(const QModelIndex& parent, int first, int last)
+{
+    Edit edit;
+    edit.type = Edit::Remove;
+    edit.parentPath = m_model->path(parent);
+    edit.row = first;
+    edit.count = last - first + 1;
+    applyEdit(edit);
+}
+
+void SearchIndex::rowsAboutToBeMoved(const QModelIndex& sourceParent, int sourceStart, int sourceEnd, const QModelIndex& destinationParent, int destinationRow)
+{
+    // after the move the parent paths may have shifted already
+    m_moveEdit.type = Edit::Move;
+    m_moveEdit.parentPath = m_model->path(sourceParent);
+    m_moveEdit.row = sourceStart;
+    m_moveEdit.count = sourceEnd - sourceStart + 1;
+    m_moveEdit.destinationPath = m_model->path(destinationParent);
+    m_moveEdit.destination = destinationRow;
+}
+
+void SearchIndex::rowsMoved()
+{
+    applyEdit(m_moveEdit);
+}
+
+void SearchIndex::dataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    Edit edit;
+    edit.type = Edit::Change;
+    edit.parentPath = m_model->path(topLeft.parent());
+    edit.row = topLeft.row();
+    edit.count = bottomRight.row() - topLeft.row() + 1;
+    applyEdit(edit);
+}
+
+void SearchIndex::rebuild()
+{
+    m_fullRebuild = true;
+    m_slots.clear();
+    m_pendingEdits.clear();
+    scheduleBuild();
+}
+
+void SearchIndex::applyEdit(const Edit& edit)
+{
+    // the pending rebuild covers the edit
+    if (m_fullRebuild)
+        return;
+
+    // the slots come from the running full build, the edit is
+    // recorded and replayed on its result
+    if (m_building && m_buildingFull) {
+        m_pendingEdits.append(edit);
+        return;
+    }
+
+    if (!applyEdit(m_slots, edit)) {
+        rebuild();
+        return;
+    }
+
+    scheduleBuild();
+}
+
+bool SearchIndex::applyEdit(QList<Slot>& slotList, const Edit& edit)
+{
+    switch (edit.type) {
+    case Edit::Insert:
+        return insertSlots(slotList, edit.parentPath, edit.row, edit.count);
+    case Edit::Remove: {
+        QList<Slot> carried;
+        return removeSlots(slotList, edit.parentPath, edit.row, edit.count, carried);
+    }
+    case Edit::Move: {
+        // the slots of the moved rows keep their segments
+        QList<Slot> carried;
+        if (!removeSlots(slotList, edit.parentPath, edit.row, edit.count, carried))
+            return false;
+
+        // the destination as it is without the moved rows
+        QVector<int> destinationPath = edit.destinationPath;
+        int destination = edit.destination;
+        int depth = edit.parentPath.count();
+        if (destinationPath.count() > depth && startsWith(destinationPath, edit.parentPath)) {
+            if (destinationPath[depth] >= edit.row + edit.count)
+                destinationPath[depth] -= edit.count;
+        } else if (destinationPath == edit.parentPath && destination > edit.row) {
+            destination -= edit.count;
+        }
+
+        return insertSlots(slotList, destinationPath, destination, edit.count, carried, edit.parentPath, edit.row);
+    }
+    case Edit::Change:
+        return changeSlots(slotList, edit.parentPath, edit.row, edit.count);
+    }
+
+    return false;
+}
+
+// the range bucket whose subtrees contain the node at path, SpineNode for the
+// root and for shallow nodes, whose rows are spread over several slots
+int SearchIndex::findSlot(const QList<Slot>& slotList, const QVector<int>& path)
+{
+    for (int i = 0; i < slotList.count(); i++) {
+        const Bucket& bucket = slotList[i].bucket;
+        int depth = bucket.parentPath.count();
+        if (path.count() <= depth || !startsWith(path, bucket.parentPath))
+            continue;
+
+        int row = path[depth];
+        if (row < bucket.first || row >= bucket.first + bucket.count)
+            continue;
+
+        if (!bucket.shallow)
+            return i;
+        if (path.count() == depth + 1)
+            return SpineNode;
+    }
+
+    return path.isEmpty() ? SpineNode : NoSlot;
+}
+
+bool SearchIndex::removeSlots(QList<Slot>& slotList, const QVector<int>& parentPath, int row, int count, QList<Slot>& carried)
+{
+    int containing = findSlot(slotList, parentPath);
+    if (containing >= 0) {
+        markDirty(slotList[containing]);
+        return true;
+    }
+    if (containing == NoSlot)
+        return false;
+
+    // slots inside the removed rows are taken out, later rows move up
+    int depth = parentPath.count();
+    int end = row + count;
+    QList<Slot> kept;
+    kept.reserve(slotList.count());
+
+    for (Slot& slot : slotList) {
+        Bucket& bucket = slot.bucket;
+        if (!startsWith(bucket.parentPath, parentPath)) {
+            kept.append(slot);
+            continue;
+        }
+
+        if (bucket.parentPath.count() == depth) {
+            int last = bucket.first + bucket.count;
+            if (bucket.first >= row && last <= end) {
+                carried.append(slot);
+                continue;
+            }
+
+            if (bucket.first >= end) {
+                bucket.first -= count;
+            } else if (last > row) {
+                // a range bucket loses the rows at one of its ends
+                bucket.count -= qMin(last, end) - qMax(bucket.first, row);
+                bucket.first = qMin(bucket.first, row);
+                markDirty(slot);
+            }
+        } else {
+            int& top = bucket.parentPath[depth];
+            if (top >= row && top < end) {
+                carried.append(slot);
+                continue;
+            }
+            if (top >= end)
+                top -= count;
+        }
+
+        kept.append(slot);
+    }
+
+    slotList.swap(kept);
+    return true;
+}
+
+bool SearchIndex::insertSlots(QList<Slot>& slotList, const QVector<int>& parentPath, int row, int count,
+                              const QList<Slot>& carried, const QVector<int>& sourcePath, int sourceRow)
+{
+    int containing = findSlot(slotList, parentPath);
+    if (containing >= 0) {
+        markDirty(slotList[containing]);
+        return true;
+    }
+    if (containing == NoSlot)
+        return false;
+
+    // later rows move down, the new slots go before the first one of them
+    int depth = parentPath.count();
+    QVector<int> start = parentPath;
+    start.append(row);
+    int position = slotList.count();
+    int split = -1;
+
+    for (int i = 0; i < slotList.count(); i++) {
+        Bucket& bucket = slotList[i].bucket;
+        if (startsWith(bucket.parentPath, parentPath)) {
+            if (bucket.parentPath.count() == depth) {
+                if (bucket.first >= row)
+                    bucket.first += count;
+                else if (bucket.first + bucket.count > row)
+                    split = i;
+            } else if (bucket.parentPath[depth] >= row) {
+                bucket.parentPath[depth] += count;
+            }
+        }
+
+        if (position == slotList.count() && precedes(start, bucket.parentPath, bucket.first))
+            position = i;
+    }
+
+    if (carried.isEmpty()) {
+        // new rows grow a neighbouring bucket, which is split again when it is rebuilt
+        if (split >= 0) {
+            slotList[split].bucket.count += count;
+            markDirty(slotList[split]);
+            return true;
+        }
+
+        if (position > 0) {
+            Slot& previous = slotList[position - 1];
+            const Bucket& bucket = previous.bucket;
+            if (!bucket.shallow && bucket.parentPath == parentPath && bucket.first + bucket.count == row) {
+                previous.bucket.count += count;
+                markDirty(previous);
+                return true;
+            }
+        }
+
+        if (position < slotList.count()) {
+            Slot& next = slotList[position];
+            const Bucket& bucket = next.bucket;
+            if (!bucket.shallow && bucket.parentPath == parentPath && bucket.first == row + count) {
+                next.bucket.first = row;
+                next.bucket.count += count;
+                markDirty(next);
+                return true;
+            }
+        }
+    } else if (split >= 0) {
+        // moved slots go between the two halves of the bucket
+        Slot& left = slotList[split];
+        Slot right = newSlot();
+        right.bucket = left.bucket;
+        right.bucket.first = row + count;
+        right.bucket.count = left.bucket.first + left.bucket.count - row;
+        left.bucket.count = row - left.bucket.first;
+        markDirty(left);
+        position = split + 1;
+        slotList.insert(position, right);
+    }
+
+    // moved slots get their new paths, rows without a slot get new ones
+    QList<Slot> block;
+    auto appendRange = [this, &block, &parentPath](int first, int rows) {
+        Slot slot = newSlot();
+        slot.bucket.parentPath = parentPath;
+        slot.bucket.first = first;
+        slot.bucket.count = rows;
+        slot.bucket.shallow = false;
+        block.append(slot);
+    };
+
+    int sourceDepth = sourcePath.count();
+    int next = row;
+    for (Slot slot : carried) {
+        Bucket& bucket = slot.bucket;
+        QVector<int> path = parentPath;
+        if (bucket.parentPath.count() == sourceDepth) {
+            bucket.first += row - sourceRow;
+            if (bucket.first > next)
+                appendRange(next, bucket.first - next);
+            next = bucket.first + bucket.count;
+        } else {
+            path.append(bucket.parentPath[sourceDepth] + row - sourceRow);
+            path += bucket.parentPath.mid(sourceDepth + 1);
+        }
+        bucket.parentPath = path;
+        block.append(slot);
+    }
+    if (next < row + count)
+        appendRange(next, row + count - next);
+
+    for (int i = 0; i < block.count(); i++)
+        slotList.insert(position + i, block[i]);
+
+    return true;
+}
+
+bool SearchIndex::changeSlots(QList<Slot>& slotList, const QVector<int>& parentPath, int row, int count)
+{
+    int containing = findSlot(slotList, parentPath);
+    if (containing >= 0) {
+        markDirty(slotList[containing]);
+        return true;
+    }
+    if (containing == NoSlot)
+        return false;
+
+    for (Slot& slot : slotList) {
+        const Bucket& bucket = slot.bucket;
+        if (bucket.parentPath == parentPath && bucket.first < row + count && bucket.first + bucket.count > row)
+            markDirty(slot);
+    }
+
+    return true;
+}
+
+void SearchIndex::markDirty(Slot& slot)
+{
+    slot.dirty = true;
+    slot.stamp = m_nextId++;
+}
+
+SearchIndex::Slot SearchIndex::newSlot()
+{
+    Slot slot;
+    slot.id = m_nextId++;
+    slot.stamp = slot.id;
+    slot.dirty = true;
+    return slot;
+}
+
+// building
+// @@@@@@@@
+
+void SearchIndex::scheduleBuild()
+{
+    if (!m_buildTimer.isActive())
+        m_buildTimer.start();
+}
+
+void SearchIndex::startBuild()
+{
+    // rescheduled when the running build is done
+    if (m_building)
+        return;
+
+    bool full = m_fullRebuild;
+    QVector<Bucket> regions;
+    QVector<quint64> ids;
+    QVector<quint64> stamps;
+
+    if (!full) {
+        for (const Slot& slot : m_slots) {
+            if (slot.dirty) {
+                regions.append(slot.bucket);
+                ids.append(slot.id);
+                stamps.append(slot.stamp);
+            }
+        }
+
+        if (regions.isEmpty())
+            return;
+    }
+
+    m_fullRebuild = false;
+    m_building = true;
+    m_buildingFull = full;
+    m_pendingEdits.clear();
+
+    // the copy shares all containers with the model
+    QVariant snapshot = m_model->variantTree();
+
+    m_buildWatcher.setFuture(QtConcurrent::run([snapshot, full, regions, ids, stamps]() {
+        return build(snapshot, full, regions, ids, stamps);
+    }));
+}
+
+void SearchIndex::buildFinished()
+{
+    BuildResult result = m_buildWatcher.result();
+    m_building = false;
+
+    if (!result.valid) {
+        rebuild();
+        return;
+    }
+
+    if (result.full) {
+        // a newer rebuild request supersedes this result
+        if (!m_fullRebuild) {
+            QList<Slot> slotList;
+            for (int i = 0; i < result.buckets.count(); i++) {
+                for (int j = 0; j < result.buckets[i].count(); j++) {
+                    Slot slot = newSlot();
+                    slot.bucket = result.buckets[i][j];
+                    slot.segment = result.segments[i][j];
+                    slot.dirty = false;
+                    slotList.append(slot);
+                }
+            }
+
+            // edits made while the build ran, by their paths at that time
+            bool ok = true;
+            for (const Edit& edit : m_pendingEdits)
+                ok = ok && applyEdit(slotList, edit);
+
+            if (ok)
+                m_slots = slotList;
+            else
+                m_fullRebuild = true;
+        }
+        m_pendingEdits.clear();
+    } else {
+        QHash<quint64, int> resultById;
+        for (int i = 0; i < result.ids.count(); i++)
+            resultById.insert(result.ids[i], i);
+
+        // a rebuilt bucket may come back split in several
+        QList<Slot> slotList;
+        slotList.reserve(m_slots.count());
+        for (const Slot& slot : m_slots) {
+            auto it = resultById.constFind(slot.id);
+
+            // slots edited again meanwhile stay dirty
+            if (it == resultById.constEnd() || slot.stamp != result.stamps[it.value()]) {
+                slotList.append(slot);
+                continue;
+            }
+
+            // the rows of the slot may have moved since, but not changed
+            int i = it.value();
+            for (int j = 0; j < result.buckets[i].count(); j++) {
+                Slot built = newSlot();
+                built.bucket = rebase(result.buckets[i][j], result.regions[i], slot.bucket);
+                built.segment = result.segments[i][j];
+                built.dirty = false;
+                slotList.append(built);
+            }
+        }
+        m_slots = slotList;
+    }
+
+    if (isReady())
+        emit ready();
+    else
+        scheduleBuild();
+}
+
+SearchIndex::BuildResult SearchIndex::build(const QVariant& snapshot, bool full, const QVector<Bucket>& regions,
+                                            const QVector<quint64>& ids, const QVector<quint64>& stamps)
+{
+    BuildResult result;
+    result.full = full;
+    result.valid = true;
+    result.ids = ids;
+    result.stamps = stamps;
+    result.regions = regions;
+
+    // a full build splits all rows of the root, a scalar root has none
+    if (full && childCount(snapshot) >= 0) {
+        Bucket root;
+        root.first = 0;
+        root.count = childCount(snapshot);
+        root.shallow = false;
+        result.regions.append(root);
+    }
+
+    QVector<Range> ranges;
+    QVector<int> regionEnds;
+
+    for (const Bucket& region : result.regions) {
+        const QVariant* parent = valueAt(snapshot, region.parentPath);
+        if (!parent || region.first + region.count > childCount(*parent)) {
+            result.valid = false;
+            return result;
+        }
+
+        QVector<Bucket> buckets;
+        if (region.shallow) {
+            Range range;
+            range.parent = parent;
+            range.first = region.first;
+            range.count = 1;
+            range.shallow = true;
+            if (parent->type() == QVariant::Map)
+                range.it = reinterpret_cast<const QVariantMap*>(parent->constData())->constBegin() + region.first;
+
+            buckets.append(region);
+            ranges.append(range);
+        } else {
+            split(*parent, region.parentPath, region.first, region.count, buckets, ranges);
+        }
+
+        result.buckets.append(buckets);
+        regionEnds.append(ranges.count());
+    }
+
+    // segments are independent, so they are built on all cores
+    std::function<SegmentPtr(const Range&)> buildSegment = [](const Range& range) {
+        SegmentBuilder builder;
+        return SegmentPtr(builder.build(range));
+    };
+    QVector<SegmentPtr> segments = QtConcurrent::blockingMapped<QVector<SegmentPtr>>(ranges, buildSegment);
+
+    int begin = 0;
+    for (int end : regionEnds) {
+        result.segments.append(segments.mid(begin, end - begin));
+        begin = end;
+    }
+
+    return result;
+}
+
+// cuts rows into buckets of about BucketSize nodes, a large child gets a
+// shallow bucket of its own and its rows are split in turn, so that both
+// a flat array and a wrapper like {"meta": {}, "data": [...]} split evenly
+void SearchIndex::split(const QVariant& parent, const QVector<int>& parentPath, int first, int count,
+                        QVector<Bucket>& buckets, QVector<Range>& ranges)
+{
+    bool isObject = parent.type() == QVariant::Map;
+    const QVariantList* arr = isObject ? nullptr : reinterpret_cast<const QVariantList*>(parent.constData());
+    auto it = isObject ? reinterpret_cast<const QVariantMap*>(parent.constData())->constBegin() + first
+                       : QVariantMap::const_iterator();
+
+    Bucket bucket;
+    bucket.parentPath = parentPath;
+    bucket.shallow = false;
+    Range range;
+    range.parent = &parent;
+    range.shallow = false;
+    int nodes = 0;
+
+    auto openBucket = [&](int row) {
+        bucket.first = range.first = row;
+        bucket.count = range.count = 0;
+        range.it = it;
+        nodes = 0;
+    };
+    auto closeBucket = [&]() {
+        if (bucket.count > 0) {
+            buckets.append(bucket);
+            ranges.append(range);
+        }
+    };
+
+    openBucket(first);
+    for (int row = first; row < first + count; row++) {
+        const QVariant& child = isObject ? it.value() : arr->at(row);
+        int size = countNodes(child, LargeSubtree);
+
+        if (size > LargeSubtree) {
+            closeBucket();
+
+            Bucket node = bucket;
+            node.first = row;
+            node.count = 1;
+            node.shallow = true;
+            Range nodeRange = range;
+            nodeRange.first = row;
+            nodeRange.count = 1;
+            nodeRange.shallow = true;
+            nodeRange.it = it;
+            buckets.append(node);
+            ranges.append(nodeRange);
+
+            QVector<int> path = parentPath;
+            path.append(row);
+            split(child, path, 0, childCount(child), buckets, ranges);
+
+            if (isObject)
+                it++;
+            openBucket(row + 1);
+            continue;
+        }
+
+        if (bucket.count > 0 && nodes + size > BucketSize) {
+            closeBucket();
+            openBucket(row);
+        }
+
+        bucket.count++;
+        range.count++;
+        nodes += size;
+        if (isObject)
+            it++;
+    }
+    closeBucket();
+}
+
+// moves a bucket built for the rows of from to the rows of to
+SearchIndex::Bucket SearchIndex::rebase(const Bucket& bucket, const Bucket& from, const Bucket& to)
+{
+    Bucket moved = bucket;
+    int depth = from.parentPath.count();
+
+    moved.parentPath = to.parentPath;
+    if (bucket.parentPath.count() == depth) {
+        moved.first = to.first + bucket.first - from.first;
+    } else {
+        moved.parentPath.append(to.first + bucket.parentPath[depth] - from.first);
+        moved.parentPath += bucket.parentPath.mid(depth + 1);
+    }
+
+    return moved;
+}
+
+const QVariant* SearchIndex::valueAt(const QVariant& root, const QVector<int>& path)
+{
+    const QVariant* value = &root;
+
+    for (int row : path) {
+        if (value->type() == QVariant::List) {
+            const QVariantList& arr = *reinterpret_cast<const QVariantList*>(value->constData());
+            if (row >= arr.count())
+                return nullptr;
+            value = &arr.at(row);
+        } else if (value->type() == QVariant::Map) {
+            const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(value->constData());
+            if (row >= obj.count())
+                return nullptr;
+            value = &(obj.constBegin() + row).value();
+        } else {
+            return nullptr;
+        }
+    }
+
+    return value;
+}
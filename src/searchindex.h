@@ -0,0 +1,154 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QTimer>
+#include <QVariant>
+#include <QVector>
+
+class QModelIndex;
+class VariantTreeModel;
+
+// inverted index of keys and scalar values, built on a worker thread
+// from a shared snapshot of the tree and kept current per bucket of rows
+class SearchIndex : public QObject
+{
+    Q_OBJECT
+
+    using Base = QObject;
+    using This = SearchIndex;
+
+public:
+    enum MatchMode {
+        Substring,
+        Prefix,
+        RegularExpression
+    };
+
+    enum Field {
+        Keys = 0x1,
+        Values = 0x2,
+        KeysAndValues = Keys | Values
+    };
+
+    explicit SearchIndex(VariantTreeModel* model, QObject* parent = Q_NULLPTR);
+    ~SearchIndex();
+
+    // case insensitive, returns model row paths in document order
+    QList<QVector<int>> search(const QString& text, MatchMode mode = Substring,
+                               Field fields = KeysAndValues, int limit = 10000) const;
+
+    bool isReady() const;
+
+signals:
+    void ready();
+
+private slots:
+    void rowsInserted(const QModelIndex& parent, int first, int last);
+    void rowsRemoved(const QModelIndex& parent, int first, int last);
+    void rowsAboutToBeMoved(const QModelIndex& sourceParent, int sourceStart, int sourceEnd, const QModelIndex& destinationParent, int destinationRow);
+    void rowsMoved();
+    void dataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void rebuild();
+
+    void startBuild();
+    void buildFinished();
+
+public:
+    // terms and node table of one bucket
+    struct Segment;
+    // rows of one bucket in a snapshot of the tree
+    struct Range;
+
+private:
+    using SegmentPtr = QSharedPointer<const Segment>;
+
+    // a run of sibling rows indexed by one segment, a shallow bucket
+    // holds one large container without its childs, which follow
+    // it in buckets of their own
+    struct Bucket
+    {
+        QVector<int> parentPath;
+        int first;
+        int count;
+        bool shallow;
+    };
+
+    struct Slot
+    {
+        Bucket bucket;
+        quint64 id;
+        quint64 stamp;
+        SegmentPtr segment;
+        bool dirty;
+    };
+
+    // model changes by row path, replayed on the slots of a full build
+    // which was started before them
+    struct Edit
+    {
+        enum Type { Insert, Remove, Move, Change };
+        Type type;
+        QVector<int> parentPath;
+        int row;
+        int count;
+        // paths and rows before the move
+        QVector<int> destinationPath;
+        int destination;
+    };
+
+    struct BuildResult
+    {
+        bool full;
+        bool valid;
+        QVector<quint64> ids;
+        QVector<quint64> stamps;
+        // the requested buckets and what they were split into
+        QVector<Bucket> regions;
+        QVector<QVector<Bucket>> buckets;
+        QVector<QVector<SegmentPtr>> segments;
+    };
+
+    // findSlot() results besides slot positions
+    enum { SpineNode = -1, NoSlot = -2 };
+
+    static BuildResult build(const QVariant& snapshot, bool full, const QVector<Bucket>& regions,
+                             const QVector<quint64>& ids, const QVector<quint64>& stamps);
+    static void split(const QVariant& parent, const QVector<int>& parentPath, int first, int count,
+                      QVector<Bucket>& buckets, QVector<Range>& ranges);
+    static Bucket rebase(const Bucket& bucket, const Bucket& from, const Bucket& to);
+    static const QVariant* valueAt(const QVariant& root, const QVector<int>& path);
+
+    static int findSlot(const QList<Slot>& slotList, const QVector<int>& path);
+
+    void applyEdit(const Edit& edit);
+    bool applyEdit(QList<Slot>& slotList, const Edit& edit);
+    bool removeSlots(QList<Slot>& slotList, const QVector<int>& parentPath, int row, int count, QList<Slot>& carried);
+    bool insertSlots(QList<Slot>& slotList, const QVector<int>& parentPath, int row, int count,
+                     const QList<Slot>& carried = QList<Slot>(), const QVector<int>& sourcePath = QVector<int>(), int sourceRow = 0);
+    bool changeSlots(QList<Slot>& slotList, const QVector<int>& parentPath, int row, int count);
+    void markDirty(Slot& slot);
+    Slot newSlot();
+    void scheduleBuild();
+
+    VariantTreeModel* m_model;
+
+    // buckets in document order
+    QList<Slot> m_slots;
+    quint64 m_nextId;
+
+    bool m_fullRebuild;
+    bool m_building;
+    bool m_buildingFull;
+    QList<Edit> m_pendingEdits;
+    Edit m_moveEdit;
+
+    QTimer m_buildTimer;
+    QFutureWatcher<BuildResult> m_buildWatcher;
+};
+
+#endif // SEARCHINDEX_H
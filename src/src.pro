@@ -2,21 +2,25 @@ TARGET = preyeditor
 TEMPLATE = app
 
 QT += core gui widgets
+QT += concurrent
 QT += qml quick
 
 CONFIG += c++11
 
+VERSION = 0.1.0
+DEFINES += APP_VERSION=\\\"$$VERSION\\\"
+
+include(varianttree.pri)
+
 HEADERS += \
+    cli.h \
     jsondelegate.h \
-    varianttreeitem.h \
-    varianttreemodel.h \
     varianttreewidget.h \
     yamldelegate.h
 
 SOURCES += \
+    cli.cpp \
     jsondelegate.cpp \
-    varianttreeitem.cpp \
-    varianttreemodel.cpp \
     varianttreewidget.cpp \
     yamldelegate.cpp
 
@@ -27,6 +31,3 @@ RESOURCES += resources.qrc
 # Hardened options
 # QMAKE_LFLAGS += -nopie
 # QMAKE_POST_LINK += /usr/sbin/paxctl-ng -mps preyeditor
-
-# TODO: add yaml functions
-# LIBS += -lyaml-cpp
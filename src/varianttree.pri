@@ -0,0 +1,42 @@
+# document engine shared by the editor, the benchmarks and the command line
+
+QT += core concurrent
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+LIBS += -lyaml-cpp
+
+HEADERS += \
+    $$PWD/cborreader.h \
+    $$PWD/cborwriter.h \
+    $$PWD/jsonpointer.h \
+    $$PWD/jsonquery.h \
+    $$PWD/jsonreader.h \
+    $$PWD/jsonwriter.h \
+    $$PWD/msgpackreader.h \
+    $$PWD/msgpackwriter.h \
+    $$PWD/searchindex.h \
+    $$PWD/varianttreeitem.h \
+    $$PWD/varianttreeitempool.h \
+    $$PWD/varianttreemimedata.h \
+    $$PWD/varianttreemodel.h \
+    $$PWD/yamlreader.h \
+    $$PWD/yamlwriter.h
+
+SOURCES += \
+    $$PWD/cborreader.cpp \
+    $$PWD/cborwriter.cpp \
+    $$PWD/jsonpointer.cpp \
+    $$PWD/jsonquery.cpp \
+    $$PWD/jsonreader.cpp \
+    $$PWD/jsonwriter.cpp \
+    $$PWD/msgpackreader.cpp \
+    $$PWD/msgpackwriter.cpp \
+    $$PWD/searchindex.cpp \
+    $$PWD/varianttreeitem.cpp \
+    $$PWD/varianttreeitempool.cpp \
+    $$PWD/varianttreemimedata.cpp \
+    $$PWD/varianttreemodel.cpp \
+    $$PWD/yamlreader.cpp \
+    $$PWD/yamlwriter.cpp
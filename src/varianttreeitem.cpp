@@ -1,25 +1,97 @@
+#include <algorithm>
+#include <new>
+
 #include <QDateTime>
+#include <QRegularExpression>
+#include <QSet>
 #include <QUrl>
 #include <QUuid>
 
 #include "varianttreeitem.h"
+#include "varianttreeitempool.h"
 #include "varianttreemodel.h"
 
+namespace {
+
+// interned type names, the model paints them without allocating
+struct TypeNames
+{
+    QString name;
+    QString displayName;
+};
+
+const TypeNames* typeNames(uint type)
+{
+    static const TypeNames names[] = {
+        { QStringLiteral("bool"), QStringLiteral("[bool]") },
+        { QStringLiteral("bytearray"), QStringLiteral("[bytearray]") },
+        { QStringLiteral("char"), QStringLiteral("[char]") },
+        { QStringLiteral("date"), QStringLiteral("[date]") },
+        { QStringLiteral("datetime"), QStringLiteral("[datetime]") },
+        { QStringLiteral("double"), QStringLiteral("[double]") },
+        { QStringLiteral("float"), QStringLiteral("[float]") },
+        { QStringLiteral("invalid"), QStringLiteral("[invalid]") },
+        { QStringLiteral("int"), QStringLiteral("[int]") },
+        { QStringLiteral("array"), QStringLiteral("[array]") },
+        { QStringLiteral("longlong"), QStringLiteral("[longlong]") },
+        { QStringLiteral("object"), QStringLiteral("[object]") },
+        { QStringLiteral("string"), QStringLiteral("[string]") },
+        { QStringLiteral("stringlist"), QStringLiteral("[stringlist]") },
+        { QStringLiteral("time"), QStringLiteral("[time]") },
+        { QStringLiteral("uint"), QStringLiteral("[uint]") },
+        { QStringLiteral("ulonglong"), QStringLiteral("[ulonglong]") },
+        { QStringLiteral("url"), QStringLiteral("[url]") },
+        { QStringLiteral("uuid"), QStringLiteral("[uuid]") },
+    };
+
+    switch (type) {
+    case QVariant::Bool:       return &names[0]; // json
+    case QVariant::ByteArray:  return &names[1];
+    case QVariant::Char:       return &names[2];
+    case QVariant::Date:       return &names[3];
+    case QVariant::DateTime:   return &names[4];
+    case QVariant::Double:     return &names[5]; // json
+    case QMetaType::Float:     return &names[6];
+    case QVariant::Invalid:    return &names[7]; // json
+    case QVariant::Int:        return &names[8];
+    case QVariant::List:       return &names[9]; // json
+    case QVariant::LongLong:   return &names[10];
+    case QVariant::Map:        return &names[11]; // json
+    case QVariant::String:     return &names[12]; // json
+    case QVariant::StringList: return &names[13];
+    case QVariant::Time:       return &names[14];
+    case QVariant::UInt:       return &names[15];
+    case QVariant::ULongLong:  return &names[16];
+    case QVariant::Url:        return &names[17];
+    case QVariant::Uuid:       return &names[18];
+    default:
+        break;
+    }
+
+    return nullptr;
+}
+
+} // namespace
+
 VariantTreeItem::VariantTreeItem(QVariant& value, VariantTreeItem* parent) :
     m_valuePtr(&value),
-    m_parent(parent)
+    m_parent(parent),
+    m_pool(parent ? parent->m_pool : nullptr),
+    m_fetched(false),
+    m_row(0)
 {
     Q_ASSERT(checkValue(value));
-    initChilds();
 }
 
 VariantTreeItem::VariantTreeItem(const QString& key, QVariant& value, VariantTreeItem* parent) :
     m_key(key),
     m_valuePtr(&value),
-    m_parent(parent)
+    m_parent(parent),
+    m_pool(parent ? parent->m_pool : nullptr),
+    m_fetched(false),
+    m_row(0)
 {
     Q_ASSERT(checkValue(value));
-    initChilds();
 }
 
 VariantTreeItem::~VariantTreeItem()
@@ -27,50 +99,142 @@ VariantTreeItem::~VariantTreeItem()
     destroyChilds();
 }
 
+// node allocation
+// @@@@@@@@@@@@@@@
+
+void* VariantTreeItem::allocate(VariantTreeItemPool* pool)
+{
+    if (pool)
+        return pool->allocate();
+    return ::operator new(sizeof(VariantTreeItem));
+}
+
+void VariantTreeItem::dispose(VariantTreeItem* item)
+{
+    VariantTreeItemPool* pool = item->m_pool;
+    item->~VariantTreeItem();
+
+    if (pool)
+        pool->release(item);
+    else
+        ::operator delete(item);
+}
+
+VariantTreeItem* VariantTreeItem::createChild(QVariant& value)
+{
+    return new (allocate(m_pool)) VariantTreeItem(value, this);
+}
+
+VariantTreeItem* VariantTreeItem::createChild(const QString& key, QVariant& value)
+{
+    return new (allocate(m_pool)) VariantTreeItem(key, value, this);
+}
+
 void VariantTreeItem::destroyChilds()
 {
     for (auto item : m_childs) {
-        delete item;
+        dispose(item);
     }
     m_childs.clear();
+    m_fetched = false;
 }
 
 void VariantTreeItem::initChilds()
 {
+    // browsing must not detach containers shared with snapshots,
+    // mutators call detach() which rebinds the value pointers
     if (m_valuePtr->type() == QVariant::List) {
-        QVariantList& arr = *array();
-        for (QVariant& v : arr) {
-            VariantTreeItem* child = new VariantTreeItem(v, this);
+        const QVariantList& arr = *array();
+        for (const QVariant& v : arr) {
+            VariantTreeItem* child = createChild(const_cast<QVariant&>(v));
+            child->m_row = m_childs.count();
             m_childs.append(child);
         }
     } else if (m_valuePtr->type() == QVariant::Map) {
-        QVariantMap& obj = *object();
-        auto it = obj.begin();
-        auto itEnd = obj.end();
+        const QVariantMap& obj = *object();
+        auto it = obj.constBegin();
+        auto itEnd = obj.constEnd();
         while (it != itEnd) {
             QString key = it.key();
-            QVariant& v = it.value();
-            VariantTreeItem* child = new VariantTreeItem(key, v, this);
+            QVariant& v = const_cast<QVariant&>(it.value());
+            VariantTreeItem* child = createChild(key, v);
+            child->m_row = m_childs.count();
             m_childs.append(child);
             it++;
         }
     }
+    m_fetched = true;
+}
+
+// copy-on-write support
+// @@@@@@@@@@@@@@@@@@@@@
+
+void VariantTreeItem::detachValue()
+{
+    if (m_parent)
+        m_parent->detach();
+}
+
+void VariantTreeItem::detach()
+{
+    detachValue();
+
+    if (isArray()) {
+        QVariantList& arr = *array();
+        if (!arr.isDetached()) {
+            arr.detach();
+            rebindChilds();
+        }
+    } else if (isObject()) {
+        QVariantMap& obj = *object();
+        if (!obj.isDetached()) {
+            obj.detach();
+            rebindChilds();
+        }
+    }
+}
+
+void VariantTreeItem::rebindChilds()
+{
+    if (isArray()) {
+        QVariantList& arr = *array();
+        int count = m_childs.count();
+        for (int i = 0; i < count; i++)
+            m_childs[i]->m_valuePtr = &arr[i];
+    } else if (isObject()) {
+        QVariantMap& obj = *object();
+        auto it = obj.begin();
+        for (VariantTreeItem* child : m_childs) {
+            child->m_valuePtr = &it.value();
+            it++;
+        }
+    }
+}
+
+void VariantTreeItem::updateRows(int first, int last)
+{
+    if (last < 0 || last >= m_childs.count())
+        last = m_childs.count() - 1;
+
+    for (int i = first; i <= last; i++)
+        m_childs[i]->m_row = i;
 }
 
 // internal object functions
 // @@@@@@@@@@@@@@@@@@@@@@@@@
 
+// object childs are kept in QVariantMap order, i.e. sorted by key,
+// so both lookups are binary searches
+
 int VariantTreeItem::findChildPos(const QString& key) const
 {
     Q_ASSERT(isObject());
 
-    auto itBegin = m_childs.begin();
-    auto itEnd = m_childs.end();
-    auto cnd = [&key](VariantTreeItem* item) {
-        return key == item->key();
-    };
-    auto it = std::find_if(itBegin, itEnd, cnd);
-    return it - itBegin;
+    int pos = findNewChildPos(key);
+    if (pos < m_childs.count() && key != m_childs[pos]->key())
+        return m_childs.count();
+
+    return pos;
 }
 
 int VariantTreeItem::findNewChildPos(const QString& key) const
@@ -79,23 +243,23 @@ int VariantTreeItem::findNewChildPos(const QString& key) const
 
     auto itBegin = m_childs.begin();
     auto itEnd = m_childs.end();
-    auto cnd = [&key](VariantTreeItem* item) {
-        return key <= item->key();
+    auto cnd = [](const VariantTreeItem* item, const QString& key) {
+        return item->key() < key;
     };
-    auto it = std::find_if(itBegin, itEnd, cnd);
+    auto it = std::lower_bound(itBegin, itEnd, key, cnd);
     return it - itBegin;
 }
 
-VariantTreeItem* VariantTreeItem::load(QVariant& value, VariantTreeItem* parent)
+VariantTreeItem* VariantTreeItem::load(QVariant& value, VariantTreeItemPool* pool)
 {
-    VariantTreeItem* item = new VariantTreeItem(value, parent);
-    //item->initChilds();
+    VariantTreeItem* item = new (allocate(pool)) VariantTreeItem(value);
+    item->m_pool = pool;
     return item;
 }
 
 void VariantTreeItem::destroy(VariantTreeItem* parent)
 {
-    delete parent;
+    dispose(parent);
 }
 
 // array functions
@@ -103,19 +267,52 @@ void VariantTreeItem::destroy(VariantTreeItem* parent)
 void VariantTreeItem::insertChild(int row, const QVariant& value)
 {
     Q_ASSERT(isArray());
+    fetchMore();
+    detach();
     QVariantList& arr = *array();
 
     arr.insert(row, value);
-    VariantTreeItem* item = new VariantTreeItem(arr[row], this);
+    VariantTreeItem* item = createChild(arr[row]);
     m_childs.insert(row, item);
+    updateRows(row);
+}
+
+void VariantTreeItem::insertChilds(int row, const QVariantList& values)
+{
+    Q_ASSERT(isArray());
+    fetchMore();
+    detach();
+    QVariantList& arr = *array();
+
+    int count = values.count();
+    if (count == 0)
+        return;
+
+    arr.reserve(arr.count() + count);
+    arr.append(values);
+    std::rotate(arr.begin() + row, arr.end() - count, arr.end());
+
+    // rotating moved the values between slots
+    for (int i = row; i < m_childs.count(); i++)
+        m_childs[i]->m_valuePtr = &arr[i + count];
+
+    m_childs.reserve(m_childs.count() + count);
+    for (int i = 0; i < count; i++)
+        m_childs.append(createChild(arr[row + i]));
+
+    std::rotate(m_childs.begin() + row, m_childs.end() - count, m_childs.end());
+    updateRows(row);
 }
 
 void VariantTreeItem::moveChild(int from, int to)
 {
     Q_ASSERT(isArray());
+    fetchMore();
+    detach();
 
     m_childs.move(from, to);
     array()->move(from, to);
+    updateRows(qMin(from, to), qMax(from, to));
 }
 
 // object functions
@@ -123,6 +320,8 @@ void VariantTreeItem::moveChild(int from, int to)
 void VariantTreeItem::insertChild(const QString& key, std::function<bool(int)> func, const QVariant& value)
 {
     Q_ASSERT(isObject());
+    fetchMore();
+    detach();
     QVariantMap& obj = *object();
 
     int to = findNewChildPos(key);
@@ -143,10 +342,10 @@ void VariantTreeItem::insertChild(const QString& key, std::function<bool(int)> f
         return;
 
     auto it = obj.insert(key, value);
-    VariantTreeItem* item = new VariantTreeItem(*it, this);
-    item->m_key = key;
+    VariantTreeItem* item = createChild(key, *it);
 
     m_childs.insert(to, item);
+    updateRows(to);
 
     return;
 }
@@ -154,6 +353,8 @@ void VariantTreeItem::insertChild(const QString& key, std::function<bool(int)> f
 void VariantTreeItem::removeChild(const QString& key, std::function<bool(int)> func)
 {
     Q_ASSERT(isObject());
+    fetchMore();
+    detach();
     QVariantMap& obj = *object();
 
     int row = findChildPos(key);
@@ -161,9 +362,10 @@ void VariantTreeItem::removeChild(const QString& key, std::function<bool(int)> f
         if (!func(row))
             return;
 
-        delete m_childs[row];
+        dispose(m_childs[row]);
         m_childs.removeAt(row);
         obj.remove(key);
+        updateRows(row);
     } else {
         func(-1);
         return;
@@ -175,6 +377,8 @@ void VariantTreeItem::removeChild(const QString& key, std::function<bool(int)> f
 void VariantTreeItem::setChildKey(const QString& key, std::function<bool(int)> func, int row)
 {
     Q_ASSERT(isObject());
+    fetchMore();
+    detach();
     QVariantMap& obj = *object();
 
     if (key == childKey(row)) {
@@ -205,7 +409,9 @@ void VariantTreeItem::setChildKey(const QString& key, std::function<bool(int)> f
     // m_childs.replace(to, m_childs[row]);
     // m_childs.removeAt(row);
 
-    m_childs.move(row, to > row ? (to - 1) : to);
+    int dest = to > row ? (to - 1) : to;
+    m_childs.move(row, dest);
+    updateRows(qMin(row, dest), qMax(row, dest));
 
     childItem->m_key = key;
     childItem->m_valuePtr = &val;
@@ -213,6 +419,124 @@ void VariantTreeItem::setChildKey(const QString& key, std::function<bool(int)> f
     return;
 }
 
+// batch object functions
+// @@@@@@@@@@@@@@@@@@@@@@
+
+// returns the first count keys of the form prefix + N which are not in use,
+// the children sharing the prefix are a contiguous range of the sorted map
+QStringList VariantTreeItem::freeChildKeys(const QString& prefix, int count, int first) const
+{
+    Q_ASSERT(isObject());
+    const QVariantMap& obj = *object();
+
+    QSet<int> used;
+    auto it = prefix.isEmpty() ? obj.constBegin() : obj.lowerBound(prefix);
+    auto itEnd = obj.constEnd();
+    for (; it != itEnd && it.key().startsWith(prefix); it++) {
+        QStringRef suffix = it.key().midRef(prefix.size());
+        bool ok;
+        int n = suffix.toInt(&ok);
+        if (ok && n >= 0 && suffix == QString::number(n))
+            used.insert(n);
+    }
+
+    QStringList keys;
+    keys.reserve(count);
+    for (int attempt = first; keys.count() < count && attempt >= 0; attempt++) {
+        if (!used.contains(attempt))
+            keys.append(prefix + QString::number(attempt));
+    }
+
+    return keys;
+}
+
+// keeps each wanted key when it is free, otherwise the key
+// without its numeric suffix gets the first free number from 1
+QStringList VariantTreeItem::freeChildKeys(const QStringList& wantedKeys) const
+{
+    Q_ASSERT(isObject());
+    const QVariantMap& obj = *object();
+
+    QSet<QString> taken;
+    QStringList keys;
+    keys.reserve(wantedKeys.count());
+
+    for (const QString& wanted : wantedKeys) {
+        QString key = wanted;
+
+        if (obj.contains(key) || taken.contains(key)) {
+            QString base = wanted;
+            base.remove(QRegularExpression("\\d+$"));
+
+            for (int attempt = 1; attempt > 0; attempt++) {
+                key = base + QString::number(attempt);
+                if (!obj.contains(key) && !taken.contains(key))
+                    break;
+            }
+        }
+
+        taken.insert(key);
+        keys.append(key);
+    }
+
+    return keys;
+}
+
+// final rows of the new keys, computed by one merge with the childs
+QVector<int> VariantTreeItem::newChildRows(const QStringList& sortedKeys) const
+{
+    Q_ASSERT(isObject());
+
+    QVector<int> rows;
+    rows.reserve(sortedKeys.count());
+
+    int childPos = 0;
+    int childCount = m_childs.count();
+    for (int i = 0; i < sortedKeys.count(); i++) {
+        const QString& key = sortedKeys[i];
+        while (childPos < childCount && m_childs[childPos]->key() < key)
+            childPos++;
+        rows.append(childPos + i);
+    }
+
+    return rows;
+}
+
+// inserts a contiguous run of absent keys which sort right at row
+void VariantTreeItem::insertChilds(int row, const QStringList& sortedKeys, const QVariant& value)
+{
+    QVariantList values;
+    values.reserve(sortedKeys.count());
+    for (int i = 0; i < sortedKeys.count(); i++)
+        values.append(value);
+
+    insertChilds(row, sortedKeys, values);
+}
+
+void VariantTreeItem::insertChilds(int row, const QStringList& sortedKeys, const QVariantList& values)
+{
+    Q_ASSERT(isObject());
+    Q_ASSERT(sortedKeys.count() == values.count());
+    fetchMore();
+    detach();
+    QVariantMap& obj = *object();
+
+    int count = sortedKeys.count();
+    if (count == 0)
+        return;
+
+    m_childs.reserve(m_childs.count() + count);
+    for (int i = 0; i < count; i++) {
+        const QString& key = sortedKeys[i];
+        Q_ASSERT(!obj.contains(key));
+        auto it = obj.insert(key, values[i]);
+        m_childs.append(createChild(key, *it));
+    }
+
+    std::rotate(m_childs.begin() + row, m_childs.end() - count, m_childs.end());
+    updateRows(row);
+}
+
 // moving functions
 // @@@@@@@@@@@@@@@@
 
@@ -221,6 +545,12 @@ void VariantTreeItem::moveChild(int row, VariantTreeItem* destinationParent, int
     Q_ASSERT(!isPlain());
     Q_ASSERT(destinationParent->isArray());
 
+    fetchMore();
+    destinationParent->fetchMore();
+
+    detach();
+    destinationParent->detach();
+
     if (this == destinationParent) {
         moveChild(row, destinationChild);
         return;
@@ -234,6 +564,8 @@ void VariantTreeItem::moveChild(int row, VariantTreeItem* destinationParent, int
     child->m_parent = destinationParent;
 
     destinationParent->m_childs.insert(destinationChild, child);
+    destinationParent->updateRows(destinationChild);
+    updateRows(row);
     destinationArr.insert(destinationChild, QVariant());
     QVariant& v = destinationArr[destinationChild];
 
@@ -255,6 +587,12 @@ void VariantTreeItem::moveChild(int row, VariantTreeItem* destinationParent, con
     Q_ASSERT(!isPlain());
     Q_ASSERT(destinationParent->isObject());
 
+    fetchMore();
+    destinationParent->fetchMore();
+
+    detach();
+    destinationParent->detach();
+
     if (this == destinationParent) {
         setChildKey(destinationKey, func, row);
         return;
@@ -276,6 +614,7 @@ void VariantTreeItem::moveChild(int row, VariantTreeItem* destinationParent, con
     VariantTreeItem* child = m_childs[row];
     m_childs.removeAt(row);
 
+    QString sourceKey = child->m_key;
     child->m_parent = destinationParent;
     child->m_key = destinationKey;
 
@@ -284,12 +623,144 @@ void VariantTreeItem::moveChild(int row, VariantTreeItem* destinationParent, con
     child->m_valuePtr = &v;
 
     destinationParent->m_childs.insert(to, child);
+    destinationParent->updateRows(to);
+    updateRows(row);
 
     if (isArray()) {
         array()->removeAt(row);
     } else if (isObject()) {
-        object()->remove(destinationKey);
+        object()->remove(sourceKey);
+    }
+}
+
+// moves a run of count childs into the destination array, the values
+// are swapped into new slots so containers are never copied
+void VariantTreeItem::moveChilds(int row, int count, VariantTreeItem* destinationParent, int destinationChild)
+{
+    Q_ASSERT(!isPlain());
+    Q_ASSERT(destinationParent->isArray());
+
+    fetchMore();
+    destinationParent->fetchMore();
+
+    detach();
+    destinationParent->detach();
+
+    if (count <= 0)
+        return;
+
+    if (this == destinationParent) {
+        // destinationChild is a row before the move as in beginMoveRows()
+        int first = qMin(row, destinationChild);
+        int middle = destinationChild > row ? row + count : row;
+        int last = destinationChild > row ? destinationChild : row + count;
+
+        QVariantList& arr = *array();
+        std::rotate(arr.begin() + first, arr.begin() + middle, arr.begin() + last);
+        std::rotate(m_childs.begin() + first, m_childs.begin() + middle, m_childs.begin() + last);
+
+        for (int i = first; i < last; i++)
+            m_childs[i]->m_valuePtr = &arr[i];
+        updateRows(first, last - 1);
+        return;
+    }
+
+    QVariantList& destinationArr = *destinationParent->array();
+    QList<VariantTreeItem*>& destinationChilds = destinationParent->m_childs;
+
+    destinationArr.reserve(destinationArr.count() + count);
+    destinationChilds.reserve(destinationChilds.count() + count);
+
+    for (int i = 0; i < count; i++) {
+        VariantTreeItem* child = m_childs[row + i];
+        destinationArr.append(QVariant());
+        destinationArr.last().swap(*child->m_valuePtr);
+        destinationChilds.append(child);
+
+        child->m_parent = destinationParent;
+    }
+
+    std::rotate(destinationArr.begin() + destinationChild, destinationArr.end() - count, destinationArr.end());
+    std::rotate(destinationChilds.begin() + destinationChild, destinationChilds.end() - count, destinationChilds.end());
+
+    for (int i = destinationChild; i < destinationChilds.count(); i++)
+        destinationChilds[i]->m_valuePtr = &destinationArr[i];
+    destinationParent->updateRows(destinationChild);
+
+    // source keys are still needed to erase the moved-out map entries
+    eraseChilds(row, count);
+
+    for (int i = 0; i < count; i++)
+        destinationChilds[destinationChild + i]->m_key.clear();
+}
+
+// moves a run of childs into the destination object under new keys,
+// the keys must be absent and sort next to each other in the destination
+void VariantTreeItem::moveChilds(int row, const QStringList& destinationKeys, VariantTreeItem* destinationParent, std::function<bool(int)> func)
+{
+    Q_ASSERT(!isPlain());
+    Q_ASSERT(destinationParent->isObject());
+    Q_ASSERT(this != destinationParent);
+
+    fetchMore();
+    destinationParent->fetchMore();
+
+    detach();
+    destinationParent->detach();
+
+    int count = destinationKeys.count();
+    if (count == 0)
+        return;
+
+    int to = destinationParent->findNewChildPos(destinationKeys.first());
+    if (!func(to))
+        return;
+
+    QVariantMap& destinationObj = *destinationParent->object();
+    QList<VariantTreeItem*>& destinationChilds = destinationParent->m_childs;
+
+    destinationChilds.reserve(destinationChilds.count() + count);
+
+    for (int i = 0; i < count; i++) {
+        VariantTreeItem* child = m_childs[row + i];
+        const QString& key = destinationKeys[i];
+        Q_ASSERT(!destinationObj.contains(key));
+
+        QVariant& v = *destinationObj.insert(key, QVariant());
+        v.swap(*child->m_valuePtr);
+        destinationChilds.append(child);
+
+        child->m_parent = destinationParent;
+        child->m_valuePtr = &v;
+    }
+
+    std::rotate(destinationChilds.begin() + to, destinationChilds.end() - count, destinationChilds.end());
+    destinationParent->updateRows(to);
+
+    // source keys are still needed to erase the moved-out map entries
+    eraseChilds(row, count);
+
+    for (int i = 0; i < count; i++)
+        destinationChilds[to + i]->m_key = destinationKeys[i];
+}
+
+// drops a range of childs which were moved out already
+void VariantTreeItem::eraseChilds(int row, int count)
+{
+    auto itBegin = m_childs.begin() + row;
+
+    if (isArray()) {
+        QVariantList& arr = *array();
+        arr.erase(arr.begin() + row, arr.begin() + row + count);
+    } else if (isObject()) {
+        QVariantMap& obj = *object();
+        auto it = obj.find((*itBegin)->m_key);
+        for (int i = 0; i < count; i++)
+            it = obj.erase(it);
     }
+
+    m_childs.erase(itBegin, itBegin + count);
+    updateRows(row);
 }
 
 // array and object functions
@@ -298,6 +769,8 @@ void VariantTreeItem::moveChild(int row, VariantTreeItem* destinationParent, con
 void VariantTreeItem::removeChild(int row)
 {
     Q_ASSERT(isArray() || isObject());
+    fetchMore();
+    detach();
 
     auto itBegin = m_childs.begin();
     auto it = itBegin + row;
@@ -309,8 +782,40 @@ void VariantTreeItem::removeChild(int row)
         object()->remove(key);
     }
 
-    delete *it;
+    dispose(*it);
     m_childs.erase(it);
+    updateRows(row);
+}
+
+// removes a contiguous range with a single erase per container
+void VariantTreeItem::removeChilds(int row, int count)
+{
+    Q_ASSERT(isArray() || isObject());
+    fetchMore();
+    detach();
+
+    if (count <= 0)
+        return;
+
+    auto itBegin = m_childs.begin() + row;
+    auto itEnd = itBegin + count;
+
+    if (isArray()) {
+        QVariantList& arr = *array();
+        arr.erase(arr.begin() + row, arr.begin() + row + count);
+    } else if (isObject()) {
+        // the range is contiguous in the map as well
+        QVariantMap& obj = *object();
+        auto it = obj.find((*itBegin)->m_key);
+        for (int i = 0; i < count; i++)
+            it = obj.erase(it);
+    }
+
+    for (auto it = itBegin; it != itEnd; it++)
+        dispose(*it);
+
+    m_childs.erase(itBegin, itEnd);
+    updateRows(row);
 }
 
 // array <--> object
@@ -319,13 +824,17 @@ void VariantTreeItem::removeChild(int row)
 void VariantTreeItem::arrayToObject()
 {
     Q_ASSERT(isArray());
+    fetchMore();
+    detach();
 
     QVariant value = QVariantMap();
     QVariantMap* obj = reinterpret_cast<QVariantMap*>(value.data());
 
+    // zero padded numbers keep the map order equal to the array order
     int count = m_childs.count();
+    int width = QString::number(qMax(count - 1, 0)).size();
     for (int i = 0; i < count; i++) {
-        QString num = QString("Item%1").arg(i);
+        QString num = QString("Item%1").arg(i, width, 10, QChar('0'));
         auto it = obj->insert(num, QVariant());
 
         VariantTreeItem* item = m_childs[i];
@@ -340,6 +849,8 @@ void VariantTreeItem::arrayToObject()
 void VariantTreeItem::objectToArray()
 {
     Q_ASSERT(isObject());
+    fetchMore();
+    detach();
 
     QVariant value = QVariantList();
     QVariantList* arr = reinterpret_cast<QVariantList*>(value.data());
@@ -367,6 +878,8 @@ void VariantTreeItem::objectToArray()
 
 void VariantTreeItem::clear()
 {
+    detachValue();
+
     if (isArray() || isObject())
         destroyChilds();
     m_valuePtr->clear();
@@ -375,6 +888,7 @@ void VariantTreeItem::clear()
 void VariantTreeItem::clearArray()
 {
     Q_ASSERT(isArray());
+    detachValue();
 
     destroyChilds();
     array()->clear();
@@ -383,11 +897,31 @@ void VariantTreeItem::clearArray()
 void VariantTreeItem::clearObject()
 {
     Q_ASSERT(isObject());
+    detachValue();
 
     destroyChilds();
     object()->clear();
 }
 
+// lazy children functions
+// @@@@@@@@@@@@@@@@@@@@@@@
+
+bool VariantTreeItem::canFetchMore() const
+{
+    return !m_fetched && hasChildren();
+}
+
+void VariantTreeItem::fetchMore()
+{
+    if (!m_fetched)
+        initChilds();
+}
+
+bool VariantTreeItem::hasChildren() const
+{
+    return valueCount() > 0;
+}
+
 // node functions
 // @@@@@@@@@@@@@@
 
@@ -409,15 +943,31 @@ const QString& VariantTreeItem::childKey(int row) const
     return child(row)->key();
 }
 
+int VariantTreeItem::childRow(const QString& key) const
+{
+    Q_ASSERT(isObject());
+    int row = findChildPos(key);
+    return row < m_childs.count() ? row : -1;
+}
+
 int VariantTreeItem::childCount() const
 {
     return m_childs.count();
 }
 
+int VariantTreeItem::valueCount() const
+{
+    if (isArray())
+        return array()->count();
+    else if (isObject())
+        return object()->count();
+    return 0;
+}
+
 int VariantTreeItem::row() const
 {
     Q_ASSERT(hasParent());
-    return m_parent->m_childs.indexOf(const_cast<VariantTreeItem*>(this));
+    return m_row;
 }
 
 // value getters
@@ -455,12 +1005,11 @@ void VariantTreeItem::setObject(const QVariantMap& obj)
 void VariantTreeItem::setValue(const QVariant& value)
 {
     Q_ASSERT(checkValue(value));
+    detachValue();
 
-    if (isArray() || isObject())
-        destroyChilds();
+    destroyChilds();
 
     *m_valuePtr = value;
-    initChilds();
 }
 
 // node value type getters
@@ -482,34 +1031,23 @@ QJsonValue::Type VariantTreeItem::jsonType() const
 
 QString VariantTreeItem::typeName() const
 {
-    uint type = valueType();
-
-    switch (type) {
-    case QVariant::Bool:        return QString("bool");         // json
-    case QVariant::Char:        return QString("char");
-    case QVariant::Date:        return QString("date");
-    case QVariant::DateTime:    return QString("datetime");
-    case QVariant::Double:      return QString("double");       // json
-    case QMetaType::Float:      return QString("float");
-    case QVariant::Invalid:     return QString("invalid");      // json
-    case QVariant::Int:         return QString("int");
-    case QVariant::List:        return QString("array");        // json
-    case QVariant::LongLong:    return QString("longlong");
-    case QVariant::Map:         return QString("object");       // json
-    case QVariant::String:      return QString("string");       // json
-    case QVariant::StringList:  return QString("stringlist");
-    case QVariant::Time:        return QString("time");
-    case QVariant::UInt:        return QString("uint");
-    case QVariant::ULongLong:   return QString("ulonglong");
-    case QVariant::Url:         return QString("url");
-    case QVariant::Uuid:        return QString("uuid");
-    default:
-        break;
-    }
+    const TypeNames* names = typeNames(valueType());
+    if (names)
+        return names->name;
 
     return QString(":%1:").arg(m_valuePtr->typeName());
 }
 
+const QString& VariantTreeItem::typeDisplayName() const
+{
+    const TypeNames* names = typeNames(valueType());
+    if (names)
+        return names->displayName;
+
+    static const QString unknown = QStringLiteral("[unknown]");
+    return unknown;
+}
+
 // value validation
 // @@@@@@@@@@@@@@@@
 
@@ -519,6 +1057,7 @@ bool VariantTreeItem::checkValue(const QVariant& value)
 
     switch (type) {
     case QVariant::Bool:        return true; // json
+    case QVariant::ByteArray:   return true;
     case QVariant::Char:        return true;
     case QVariant::Date:        return true;
     case QVariant::DateTime:    return true;
@@ -556,6 +1095,11 @@ bool VariantTreeItem::convertTo(QVariant::Type to, bool force)
         ok = true;
         break;
     }
+    case QVariant::ByteArray: {
+        newValue = m_valuePtr->toByteArray();
+        ok = true;
+        break;
+    }
     case QVariant::Char: {
         newValue = m_valuePtr->toChar();
         ok = true;
@@ -651,11 +1195,10 @@ bool VariantTreeItem::convertTo(QVariant::Type to, bool force)
     }
 
     if (ok || force) {
-        if (isArray() || isObject())
-            destroyChilds();
+        detachValue();
+        destroyChilds();
 
         *m_valuePtr = std::move(newValue);
-        initChilds();
 
         return true;
     }
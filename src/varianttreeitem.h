@@ -3,10 +3,13 @@
 
 #include <functional>
 
+#include <QStringList>
 #include <QVariant>
+#include <QVector>
 #include <QJsonValue>
 
 class JsonModel;
+class VariantTreeItemPool;
 
 class VariantTreeItem
 {
@@ -16,32 +19,56 @@ class VariantTreeItem
     VariantTreeItem(const QString& key, QVariant& value, VariantTreeItem* parent = nullptr);
     ~VariantTreeItem();
 
+    // node allocation
+    static void* allocate(VariantTreeItemPool* pool);
+    static void dispose(VariantTreeItem* item);
+    VariantTreeItem* createChild(QVariant& value);
+    VariantTreeItem* createChild(const QString& key, QVariant& value);
+
     inline void destroyChilds();
-    inline void initChilds();
+    void initChilds();
+    void updateRows(int first, int last = -1);
+    void eraseChilds(int row, int count);
+
+    // copy-on-write support
+    void detachValue();
+    void detach();
+    void rebindChilds();
 
     // internal object functions
     int findChildPos(const QString& key) const;
     int findNewChildPos(const QString& key) const;
 
 public:
-    static VariantTreeItem* load(QVariant& value, VariantTreeItem* parent = nullptr);
+    static VariantTreeItem* load(QVariant& value, VariantTreeItemPool* pool = nullptr);
     static void destroy(VariantTreeItem* parent);
 
     // array functions
     void insertChild(int row, const QVariant& value = QVariant());
     void moveChild(int from, int to);
+    void insertChilds(int row, const QVariantList& values);
 
     // object functions
     void insertChild(const QString& key, std::function<bool(int)> func, const QVariant& value = QVariant());
     void removeChild(const QString& key, std::function<bool(int)> func);
     void setChildKey(const QString& key, std::function<bool(int)> func, int row);
 
+    // batch object functions
+    QStringList freeChildKeys(const QString& prefix, int count, int first = 0) const;
+    QStringList freeChildKeys(const QStringList& wantedKeys) const;
+    QVector<int> newChildRows(const QStringList& sortedKeys) const;
+    void insertChilds(int row, const QStringList& sortedKeys, const QVariant& value = QVariant());
+    void insertChilds(int row, const QStringList& sortedKeys, const QVariantList& values);
+
     // moving functions
     void moveChild(int row, VariantTreeItem* destinationParent, int destinationChild);
     void moveChild(int row, VariantTreeItem* destinationParent, const QString& destinationKey, std::function<bool(int)> func);
+    void moveChilds(int row, int count, VariantTreeItem* destinationParent, int destinationChild);
+    void moveChilds(int row, const QStringList& destinationKeys, VariantTreeItem* destinationParent, std::function<bool(int)> func);
 
     // array and object functions
     void removeChild(int row);
+    void removeChilds(int row, int count);
 
     // array <--> object
     void arrayToObject();
@@ -52,13 +79,20 @@ public:
     void clearArray();
     void clearObject();
 
+    // lazy children functions
+    bool canFetchMore() const;
+    void fetchMore();
+    bool hasChildren() const;
+
     // node functions
     VariantTreeItem* parent()
     { return m_parent; }
     VariantTreeItem* child(int row);
     const VariantTreeItem* child(int row) const;
     const QString& childKey(int row) const;
+    int childRow(const QString& key) const;
     int childCount() const;
+    int valueCount() const;
     int row() const;
 
     // value getters
@@ -78,6 +112,7 @@ public:
     { return m_valuePtr->type(); }
     QJsonValue::Type jsonType() const;
     QString typeName() const;
+    const QString& typeDisplayName() const;
 
     // node state getters
     inline bool hasParent() const
@@ -122,6 +157,9 @@ private:
 
     VariantTreeItem* m_parent;
     QList<VariantTreeItem*> m_childs;
+    VariantTreeItemPool* m_pool;
+    bool m_fetched;
+    int m_row;
 };
 
 #endif // VARIANTTREEITEM_H
@@ -0,0 +1,61 @@
+#include <new>
+
+#include "varianttreeitempool.h"
+
+VariantTreeItemPool::VariantTreeItemPool(std::size_t itemSize, int slabItems) :
+    m_slabItems(slabItems),
+    m_slabPos(nullptr),
+    m_slabEnd(nullptr),
+    m_freeList(nullptr)
+{
+    // keep every item aligned as operator new would do
+    const std::size_t align = alignof(std::max_align_t);
+    if (itemSize < sizeof(FreeNode))
+        itemSize = sizeof(FreeNode);
+    m_itemSize = (itemSize + align - 1) / align * align;
+}
+
+VariantTreeItemPool::~VariantTreeItemPool()
+{
+    clear();
+}
+
+void* VariantTreeItemPool::allocate()
+{
+    if (m_freeList) {
+        FreeNode* node = m_freeList;
+        m_freeList = node->next;
+        return node;
+    }
+
+    if (m_slabPos == m_slabEnd) {
+        std::size_t slabSize = m_itemSize * m_slabItems;
+        char* slab = static_cast<char*>(::operator new(slabSize));
+        m_slabs.append(slab);
+
+        m_slabPos = slab;
+        m_slabEnd = slab + slabSize;
+    }
+
+    void* ptr = m_slabPos;
+    m_slabPos += m_itemSize;
+    return ptr;
+}
+
+void VariantTreeItemPool::release(void* ptr)
+{
+    FreeNode* node = static_cast<FreeNode*>(ptr);
+    node->next = m_freeList;
+    m_freeList = node;
+}
+
+void VariantTreeItemPool::clear()
+{
+    for (char* slab : m_slabs)
+        ::operator delete(slab);
+    m_slabs.clear();
+
+    m_slabPos = nullptr;
+    m_slabEnd = nullptr;
+    m_freeList = nullptr;
+}
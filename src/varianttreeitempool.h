@@ -0,0 +1,43 @@
+#ifndef VARIANTTREEITEMPOOL_H
+#define VARIANTTREEITEMPOOL_H
+
+#include <cstddef>
+
+#include <QVector>
+
+class VariantTreeItemPool
+{
+    using This = VariantTreeItemPool;
+
+public:
+    explicit VariantTreeItemPool(std::size_t itemSize, int slabItems = 4096);
+    ~VariantTreeItemPool();
+
+    void* allocate();
+    void release(void* ptr);
+
+    // frees all slabs at once, every item must be destroyed before
+    void clear();
+
+    int slabCount() const
+    { return m_slabs.count(); }
+
+private:
+    Q_DISABLE_COPY(VariantTreeItemPool)
+
+    struct FreeNode
+    {
+        FreeNode* next;
+    };
+
+    std::size_t m_itemSize;
+    int m_slabItems;
+
+    QVector<char*> m_slabs;
+    char* m_slabPos;
+    char* m_slabEnd;
+
+    FreeNode* m_freeList;
+};
+
+#endif // VARIANTTREEITEMPOOL_H
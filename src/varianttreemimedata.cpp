@@ -0,0 +1,87 @@
+#include <QBuffer>
+
+#include "jsonwriter.h"
+#include "varianttreemimedata.h"
+#include "varianttreemodel.h"
+
+VariantTreeMimeData::VariantTreeMimeData(const VariantTreeModel* model, const QModelIndexList& indexes, bool keepHandles) :
+    m_model(model)
+{
+    QStringList pointers;
+
+    // the values are implicitly shared, nothing is copied here
+    for (const QModelIndex& idx : indexes) {
+        const VariantTreeItem* item = model->item(idx);
+
+        if (keepHandles)
+            m_handles.append(idx);
+        m_values.append(item->value());
+        m_keys.append(item->parent()->isObject() ? item->key() : QString());
+        pointers.append(model->pointer(idx));
+    }
+
+    setData(pointersMimeType(), pointers.join('\n').toUtf8());
+}
+
+const QString& VariantTreeMimeData::nodesMimeType()
+{
+    static const QString mimeType = QStringLiteral("application/x-preyeditor-nodes");
+    return mimeType;
+}
+
+const QString& VariantTreeMimeData::jsonMimeType()
+{
+    static const QString mimeType = QStringLiteral("application/json");
+    return mimeType;
+}
+
+const QString& VariantTreeMimeData::pointersMimeType()
+{
+    static const QString mimeType = QStringLiteral("application/x-json-pointers");
+    return mimeType;
+}
+
+QModelIndexList VariantTreeMimeData::indexes() const
+{
+    QModelIndexList indexes;
+    for (const QPersistentModelIndex& handle : m_handles) {
+        if (handle.isValid())
+            indexes.append(handle);
+    }
+    return indexes;
+}
+
+QStringList VariantTreeMimeData::formats() const
+{
+    QStringList formats;
+    formats << nodesMimeType() << jsonMimeType() << QStringLiteral("text/plain");
+    formats << Base::formats();
+    return formats;
+}
+
+bool VariantTreeMimeData::hasFormat(const QString& mimeType) const
+{
+    return formats().contains(mimeType);
+}
+
+QVariant VariantTreeMimeData::retrieveData(const QString& mimeType, QVariant::Type type) const
+{
+    if (mimeType == nodesMimeType())
+        return QByteArray();
+
+    if (mimeType != jsonMimeType() && mimeType != "text/plain")
+        return Base::retrieveData(mimeType, type);
+
+    // one node is dropped as itself, several as an array
+    if (m_json.isEmpty()) {
+        QBuffer buffer(&m_json);
+        buffer.open(QIODevice::WriteOnly);
+
+        JsonWriter writer(&buffer);
+        writer.write(m_values.count() == 1 ? m_values.first() : QVariant(m_values));
+    }
+
+    if (type == QVariant::String)
+        return QString::fromUtf8(m_json);
+    return m_json;
+}
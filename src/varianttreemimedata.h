@@ -0,0 +1,57 @@
+#ifndef VARIANTTREEMIMEDATA_H
+#define VARIANTTREEMIMEDATA_H
+
+#include <QMimeData>
+#include <QPersistentModelIndex>
+#include <QPointer>
+#include <QStringList>
+#include <QVariant>
+
+class VariantTreeModel;
+
+// drag payload: handles of the dragged nodes and shared snapshots of
+// their values, JSON is serialized only when a drop target asks for it
+class VariantTreeMimeData : public QMimeData
+{
+    Q_OBJECT
+
+    using Base = QMimeData;
+    using This = VariantTreeMimeData;
+
+public:
+    // indexes are column 0 nodes in document order, handles are kept
+    // for moves only, a clipboard snapshot needs the values alone
+    VariantTreeMimeData(const VariantTreeModel* model, const QModelIndexList& indexes, bool keepHandles = true);
+
+    static const QString& nodesMimeType();
+    static const QString& jsonMimeType();
+    static const QString& pointersMimeType();
+
+    const VariantTreeModel* model() const
+    { return m_model; }
+    // current places of the nodes, removed ones are skipped
+    QModelIndexList indexes() const;
+
+    // keys are empty for array items
+    const QVariantList& values() const
+    { return m_values; }
+    const QStringList& keys() const
+    { return m_keys; }
+
+    QStringList formats() const;
+    bool hasFormat(const QString& mimeType) const;
+
+protected:
+    QVariant retrieveData(const QString& mimeType, QVariant::Type type) const;
+
+private:
+    QPointer<const VariantTreeModel> m_model;
+    QList<QPersistentModelIndex> m_handles;
+
+    QVariantList m_values;
+    QStringList m_keys;
+
+    mutable QByteArray m_json;
+};
+
+#endif // VARIANTTREEMIMEDATA_H
@@ -1,72 +1,506 @@
+#include <algorithm>
+#include <climits>
+
+#include <QElapsedTimer>
 #include <QFile>
-#include <QJsonDocument>
+#include <QFileInfo>
+#include <QHash>
+#include <QMimeData>
 #include <QRegularExpression>
-
+#include <QSaveFile>
+#include <QSet>
+#include <QtConcurrent>
+
+#include "cborreader.h"
+#include "cborwriter.h"
+#include "jsonpointer.h"
+#include "jsonreader.h"
+#include "msgpackreader.h"
+#include "msgpackwriter.h"
+#include "yamlreader.h"
+#include "yamlwriter.h"
+#include "varianttreemimedata.h"
 #include "varianttreemodel.h"
 
+namespace {
+
+const qint64 ReadChunkSize = 1 << 20;
+
+// smaller documents are not worth the pre-scan
+const qint64 ParallelLoadSize = 16 << 20;
+
+// resolved pointers kept for navigation
+const int PointerCacheSize = 1024;
+
+const QString& arrayItemText()
+{
+    static const QString text = QStringLiteral("[array item]");
+    return text;
+}
+
+// reads a pipe or a socket until the peer closes it
+QByteArray readSequential(QIODevice* device)
+{
+    QByteArray data;
+    qint64 size = 0;
+
+    forever {
+        data.resize(size + ReadChunkSize);
+        qint64 n = device->read(data.data() + size, ReadChunkSize);
+        if (n > 0) {
+            size += n;
+            continue;
+        }
+        if (n < 0)
+            break;
+        if (!device->waitForReadyRead(-1))
+            break;
+    }
+
+    data.resize(size);
+    return data;
+}
+
+// read errors of files, other devices keep no error state
+bool readFailed(QIODevice* device)
+{
+    QFileDevice* file = qobject_cast<QFileDevice*>(device);
+    return file && file->error() != QFileDevice::NoError;
+}
+
+} // namespace
+
 VariantTreeModel::VariantTreeModel(QObject* parent) :
-    QAbstractItemModel(parent)
+    QAbstractItemModel(parent),
+    m_itemPool(sizeof(VariantTreeItem)),
+    m_errorOffset(-1),
+    m_errorLine(0),
+    m_ioError(false),
+    m_parallelLoad(true),
+    m_fetching(false),
+    m_pointerCache(PointerCacheSize),
+    m_documentFormat(Json),
+    m_multiDocument(false),
+    m_transactionDepth(0),
+    m_transactionEdits(0),
+    m_layoutChanging(false),
+    m_replaying(false)
 {
-    m_rootItem = VariantTreeItem::load(m_variantTree);
+    m_rootItem = VariantTreeItem::load(m_variantTree, &m_itemPool);
+
+    connect(&m_loadWatcher, SIGNAL(finished()), SLOT(loadAsyncFinished()));
+    connect(&m_saveWatcher, SIGNAL(finished()), SLOT(saveAsyncFinished()));
 }
 
 VariantTreeModel::~VariantTreeModel()
-{ }
+{
+    cancelLoad();
+    m_loadWatcher.waitForFinished();
+    m_saveWatcher.waitForFinished();
+
+    VariantTreeItem::destroy(m_rootItem);
+}
 
 bool VariantTreeModel::load(const QString& fileName)
 {
+    LoadResult result = loadFile(fileName, m_parallelLoad, LoadProgressFunc());
+    return applyLoadResult(result);
+}
+
+VariantTreeModel::DocumentFormat VariantTreeModel::formatForFileName(const QString& fileName)
+{
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "yaml" || suffix == "yml")
+        return Yaml;
+    if (suffix == "cbor")
+        return Cbor;
+    if (suffix == "msgpack" || suffix == "mpk")
+        return MessagePack;
+    return Json;
+}
+
+bool VariantTreeModel::load(QIODevice* device, DocumentFormat format)
+{
+    QByteArray data = device->isSequential() ? readSequential(device) : device->readAll();
+
+    LoadResult result;
+    if (readFailed(device)) {
+        result.errorString = device->errorString();
+        result.ioError = true;
+    } else {
+        result = parseDocument(data.constData(), data.size(), format, m_parallelLoad, LoadProgressFunc());
+    }
+
+    return applyLoadResult(result);
+}
+
+bool VariantTreeModel::loadJson(const QByteArray& json)
+{
+    return loadJson(json.constData(), json.size());
+}
+
+bool VariantTreeModel::loadJson(const char* data, qint64 size)
+{
+    LoadResult result = parseJson(data, size, m_parallelLoad, LoadProgressFunc());
+    return applyLoadResult(result);
+}
+
+bool VariantTreeModel::loadAsync(const QString& fileName)
+{
+    if (isLoading())
+        return false;
+
+    m_loadCancel.store(0);
+
+    auto progress = [this](qint64 bytesProcessed, qint64 bytesTotal, qint64 nodeCount) {
+        emit loadProgress(bytesProcessed, bytesTotal, nodeCount);
+        return m_loadCancel.load() == 0;
+    };
+
+    bool parallel = m_parallelLoad;
+    m_loadWatcher.setFuture(QtConcurrent::run([fileName, parallel, progress]() {
+        return loadFile(fileName, parallel, progress);
+    }));
+
+    return true;
+}
+
+void VariantTreeModel::cancelLoad()
+{
+    m_loadCancel.store(1);
+}
+
+bool VariantTreeModel::isLoading() const
+{
+    return m_loadWatcher.isRunning();
+}
+
+void VariantTreeModel::loadAsyncFinished()
+{
+    LoadResult result = m_loadWatcher.result();
+
+    bool success = applyLoadResult(result);
+    emit loadFinished(success);
+}
+
+VariantTreeModel::LoadResult VariantTreeModel::loadFile(const QString& fileName, bool parallel, const LoadProgressFunc& progress)
+{
+    LoadResult result;
+
     QFile file(fileName);
-    bool success = false;
-    if (file.open(QIODevice::ReadOnly)) {
-        success = load(&file);
-        file.close();
-    } else
-        success = false;
+    if (!file.open(QIODevice::ReadOnly)) {
+        result.errorString = file.errorString();
+        result.ioError = true;
+        return result;
+    }
+
+    DocumentFormat format = formatForFileName(fileName);
+
+    // parse regular files straight from the page cache
+    qint64 size = file.size();
+    uchar* data = nullptr;
+    if (!file.isSequential() && size > 0)
+        data = file.map(0, size);
+
+    if (data) {
+        result = parseDocument(reinterpret_cast<const char*>(data), size, format, parallel, progress);
+        file.unmap(data);
+    } else {
+        QByteArray bytes = file.isSequential() ? readSequential(&file) : file.readAll();
+        if (readFailed(&file)) {
+            result.errorString = file.errorString();
+            result.ioError = true;
+            return result;
+        }
+        result = parseDocument(bytes.constData(), bytes.size(), format, parallel, progress);
+    }
+
+    return result;
+}
+
+VariantTreeModel::LoadResult VariantTreeModel::parseDocument(const char* data, qint64 size, DocumentFormat format, bool parallel, const LoadProgressFunc& progress)
+{
+    switch (format) {
+    case Yaml:
+        return parseYaml(data, size, parallel, progress);
+    case Cbor:
+        return parseBinary<CborReader>(data, size, format, progress);
+    case MessagePack:
+        return parseBinary<MsgPackReader>(data, size, format, progress);
+    default:
+        return parseJson(data, size, parallel, progress);
+    }
+}
+
+VariantTreeModel::LoadResult VariantTreeModel::parseJson(const char* data, qint64 size, bool parallel, const LoadProgressFunc& progress)
+{
+    LoadResult result;
+    JsonReader reader(data, size);
+
+    if (progress) {
+        reader.setProgressFunc([&progress, size](qint64 bytesProcessed, qint64 nodeCount) {
+            return progress(bytesProcessed, size, nodeCount);
+        });
+    }
+
+    if (parallel && size >= ParallelLoadSize)
+        result.success = reader.readParallel(result.value);
+    else
+        result.success = reader.read(result.value);
+    if (!result.success) {
+        result.errorString = reader.errorString();
+        result.errorOffset = reader.errorOffset();
+        result.errorLine = reader.errorLine();
+    }
+
+    return result;
+}
+
+VariantTreeModel::LoadResult VariantTreeModel::parseYaml(const char* data, qint64 size, bool parallel, const LoadProgressFunc& progress)
+{
+    LoadResult result;
+    result.format = Yaml;
+    YamlReader reader(data, size);
+
+    if (progress) {
+        reader.setProgressFunc([&progress, size](qint64 bytesProcessed, qint64 nodeCount) {
+            return progress(bytesProcessed, size, nodeCount);
+        });
+    }
+
+    if (parallel && size >= ParallelLoadSize)
+        result.success = reader.readParallel(result.value);
+    else
+        result.success = reader.read(result.value);
+    if (!result.success) {
+        result.errorString = reader.errorString();
+        result.errorOffset = reader.errorOffset();
+        result.errorLine = reader.errorLine();
+    }
+
+    result.multiDocument = reader.documentCount() > 1;
+    return result;
+}
+
+template<typename Reader>
+VariantTreeModel::LoadResult VariantTreeModel::parseBinary(const char* data, qint64 size, DocumentFormat format, const LoadProgressFunc& progress)
+{
+    LoadResult result;
+    result.format = format;
+    Reader reader(data, size);
+
+    if (progress) {
+        reader.setProgressFunc([&progress, size](qint64 bytesProcessed, qint64 nodeCount) {
+            return progress(bytesProcessed, size, nodeCount);
+        });
+    }
+
+    // length prefixed items leave nothing to split ahead of parsing
+    result.success = reader.read(result.value);
+    if (!result.success) {
+        result.errorString = reader.errorString();
+        result.errorOffset = reader.errorOffset();
+    }
+
+    result.multiDocument = reader.documentCount() > 1;
+    return result;
+}
+
+bool VariantTreeModel::applyLoadResult(LoadResult& result)
+{
+    if (!result.success) {
+        setError(result.errorString, result.errorOffset, result.errorLine);
+        m_ioError = result.ioError;
+        return false;
+    }
+
+    setError(QString());
+    resetVariantTree(result.value);
+
+    m_documentFormat = result.format;
+    m_multiDocument = result.multiDocument;
+    return true;
+}
+
+bool VariantTreeModel::save(const QString& fileName, JsonWriter::Format format)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        setError(file.errorString());
+        return false;
+    }
+
+    bool success = save(&file, formatForFileName(fileName), format);
+    file.close();
 
     return success;
 }
 
-bool VariantTreeModel::load(QIODevice* device)
+bool VariantTreeModel::save(QIODevice* device, JsonWriter::Format format)
 {
-    return loadJson(device->readAll());
+    return save(device, Json, format);
 }
 
-bool VariantTreeModel::loadJson(const QByteArray& json)
+bool VariantTreeModel::save(QIODevice* device, DocumentFormat documentFormat, JsonWriter::Format format)
+{
+    SaveResult result = writeDocument(device, m_variantTree, documentFormat, m_multiDocument, format, JsonWriter::ProgressFunc());
+    setError(result.errorString);
+    return result.success;
+}
+
+bool VariantTreeModel::saveAsync(const QString& fileName, JsonWriter::Format format)
 {
-    QJsonDocument jdoc;
-    jdoc = QJsonDocument::fromJson(json);
+    if (isSaving())
+        return false;
 
-    if (!jdoc.isNull()) {
-        beginResetModel(); {
-            VariantTreeItem::destroy(m_rootItem);
+    // the copy shares all containers with the tree,
+    // items detach only what gets edited while writing
+    QVariant snapshot = m_variantTree;
 
-            m_variantTree = jdoc.toVariant();
-            m_rootItem = VariantTreeItem::load(m_variantTree);
-        } endResetModel();
-        return true;
+    DocumentFormat documentFormat = formatForFileName(fileName);
+    bool multiDocument = m_multiDocument;
+
+    auto progress = [this](qint64 bytesWritten) {
+        emit saveProgress(bytesWritten);
+    };
+
+    m_saveWatcher.setFuture(QtConcurrent::run([fileName, snapshot, documentFormat, multiDocument, format, progress]() {
+        return saveFile(fileName, snapshot, documentFormat, multiDocument, format, progress);
+    }));
+
+    return true;
+}
+
+bool VariantTreeModel::isSaving() const
+{
+    return m_saveWatcher.isRunning();
+}
+
+void VariantTreeModel::saveAsyncFinished()
+{
+    SaveResult result = m_saveWatcher.result();
+
+    setError(result.errorString);
+    emit saveFinished(result.success, result.bytesWritten, result.elapsedMs);
+}
+
+VariantTreeModel::SaveResult VariantTreeModel::saveFile(const QString& fileName, const QVariant& value, DocumentFormat documentFormat, bool multiDocument,
+                                                        JsonWriter::Format format, const JsonWriter::ProgressFunc& progress)
+{
+    SaveResult result;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // the target file is replaced only after a complete write
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        result.errorString = file.errorString();
+        return result;
     }
-    return false;
+
+    result = writeDocument(&file, value, documentFormat, multiDocument, format, progress);
+
+    if (!result.success) {
+        file.cancelWriting();
+    } else if (!file.commit()) {
+        result.errorString = file.errorString();
+        result.success = false;
+    }
+
+    result.elapsedMs = timer.elapsed();
+    return result;
 }
 
-bool VariantTreeModel::loadVariantTree(const QVariant& v)
+VariantTreeModel::SaveResult VariantTreeModel::writeDocument(QIODevice* device, const QVariant& value, DocumentFormat documentFormat, bool multiDocument,
+                                                             JsonWriter::Format format, const JsonWriter::ProgressFunc& progress)
 {
-    beginResetModel(); {
-        VariantTreeItem::destroy(m_rootItem);
+    SaveResult result;
+
+    switch (documentFormat) {
+    case Yaml:
+        return writeStream<YamlWriter>(device, value, multiDocument, progress);
+    case Cbor:
+        return writeStream<CborWriter>(device, value, multiDocument, progress);
+    case MessagePack:
+        return writeStream<MsgPackWriter>(device, value, multiDocument, progress);
+    default:
+        break;
+    }
 
-        m_variantTree = v;
-        m_rootItem = VariantTreeItem::load(m_variantTree);
-    } endResetModel();
+    JsonWriter writer(device, format);
+    writer.setProgressFunc(progress);
+
+    result.success = writer.write(value);
+    result.errorString = writer.errorString();
+    result.bytesWritten = writer.bytesWritten();
+    return result;
+}
+
+template<typename Writer>
+VariantTreeModel::SaveResult VariantTreeModel::writeStream(QIODevice* device, const QVariant& value, bool multiDocument,
+                                                           const JsonWriter::ProgressFunc& progress)
+{
+    SaveResult result;
+
+    Writer writer(device);
+    writer.setProgressFunc(progress);
+
+    result.success = writer.write(value, multiDocument);
+    result.errorString = writer.errorString();
+    result.bytesWritten = writer.bytesWritten();
+    return result;
+}
+
+bool VariantTreeModel::loadVariantTree(const QVariant& v)
+{
+    QVariant value = v;
+    resetVariantTree(value);
     return true;
 }
 
 void VariantTreeModel::destroy()
 {
+    QVariant value;
+    resetVariantTree(value);
+}
+
+void VariantTreeModel::resetVariantTree(QVariant& value)
+{
+    // a pending layout change must not outlive the items it tracks
+    if (m_layoutChanging) {
+        m_layoutItems.fill(nullptr);
+        publish();
+    }
+    m_pendingData.clear();
+    m_pointerCache.clear();
+
+    m_documentFormat = Json;
+    m_multiDocument = false;
+
+    // recorded paths refer to the old tree
+    m_undoStack.clear();
+    m_redoStack.clear();
+    m_undoGroup.clear();
+
     beginResetModel(); {
         VariantTreeItem::destroy(m_rootItem);
+        m_itemPool.clear();
 
-        m_variantTree.clear();
-        m_rootItem = VariantTreeItem::load(m_variantTree);
+        m_variantTree.swap(value);
+        value.clear();
+        m_rootItem = VariantTreeItem::load(m_variantTree, &m_itemPool);
     } endResetModel();
+
+    emit undoStackChanged();
+}
+
+void VariantTreeModel::setError(const QString& error, qint64 offset, int line)
+{
+    m_errorString = error;
+    m_errorOffset = offset;
+    m_errorLine = line;
+    m_ioError = false;
 }
 
 Qt::ItemFlags VariantTreeModel::flags(const QModelIndex& index) const
@@ -124,7 +558,7 @@ QVariant VariantTreeModel::data(const QModelIndex& index, int role) const
         switch (column) {
         case KeyColumn: {
             if (parentItem->isArray())
-                value = QString("[array item]");
+                value = arrayItemText();
             else
                 value = item->key();
             break;
@@ -132,11 +566,14 @@ QVariant VariantTreeModel::data(const QModelIndex& index, int role) const
         case ValueColumn: {
             if (item->isPlain())
                 value = item->value();
+
+            // binary values are shown and edited as base64 like in JSON output
+            if (value.type() == QVariant::ByteArray)
+                value = QString::fromLatin1(value.toByteArray().toBase64());
             break;
         }
         case TypeColumn: {
-            QString typeName = item->typeName();
-            value = QString("[%1]").arg(typeName);
+            value = item->typeDisplayName();
             break;
         }
         default:
@@ -154,6 +591,10 @@ QVariant VariantTreeModel::data(const QModelIndex& index, int role) const
         case ValueColumn: {
             if (item->isPlain())
                 value = item->value();
+
+            // the delegates decode the base64 text again
+            if (value.type() == QVariant::ByteArray)
+                value = QString::fromLatin1(value.toByteArray().toBase64());
             break;
         }
         case TypeColumn: {
@@ -166,6 +607,7 @@ QVariant VariantTreeModel::data(const QModelIndex& index, int role) const
         break;
     }
     case UrlRole: {
+        value = pointer(index);
         break;
     }
     default:
@@ -202,7 +644,7 @@ bool VariantTreeModel::setData(const QModelIndex& index, const QVariant& value,
             if (item->isPlain()) {
                 QVariant::Type valueType = value.type();
                 if (valueType != QVariant::List && valueType != QVariant::Map) {
-                    item->setValue(value);
+                    setValue(value, index);
                     return true;
                 }
             }
@@ -219,26 +661,46 @@ bool VariantTreeModel::setData(const QModelIndex& index, const QVariant& value,
                 return true;
 
             QModelIndex idx = parent.child(row, 0);
+            fetch(idx);
+
+            // the old subtree is shared, not copied
+            QVector<int> indexPath = path(idx);
+            QVariant oldValue = item->value();
+            recordUndo([this, indexPath, oldValue]() {
+                replaceValue(indexForPath(indexPath), oldValue);
+            }, [this, indexPath, value]() {
+                setData(indexForPath(indexPath).sibling(indexPath.last(), TypeColumn), value, Qt::EditRole);
+            });
 
             if (item->isArray()) {
-                if (toType != QVariant::Map) {
-                    beginRemoveRows(idx, 0, item->childCount() - 1);
+                if (toType != QVariant::Map && item->childCount() > 0) {
+                    beginRemove(idx, 0, item->childCount() - 1);
                     item->convertTo(toType, true);
-                    endRemoveRows();
+                    endRemove();
 
+                    changeData(parent, row, row);
                     return true;
                 }
             } else if (item->isObject()) {
-                if (toType != QVariant::List) {
-                    beginRemoveRows(idx, 0, item->childCount() - 1);
+                if (toType != QVariant::List && item->childCount() > 0) {
+                    beginRemove(idx, 0, item->childCount() - 1);
                     item->convertTo(toType, true);
-                    endRemoveRows();
+                    endRemove();
 
+                    changeData(parent, row, row);
                     return true;
                 }
             }
 
+            bool rekeyed = item->childCount() > 0;
             item->convertTo(toType, true);
+
+            // array <--> object conversion changes every child key
+            if (rekeyed) {
+                m_pointerCache.clear();
+                changeData(idx, 0, item->childCount() - 1);
+            }
+            changeData(parent, row, row);
             return true;
         }
         default:
@@ -336,30 +798,123 @@ int VariantTreeModel::columnCount(const QModelIndex& parent) const
     return 3;
 }
 
+bool VariantTreeModel::hasChildren(const QModelIndex& parent) const
+{
+    if (parent.column() > 0)
+        return false;
+
+    VariantTreeItem* parentItem = This::item(parent);
+    return parentItem->hasChildren();
+}
+
+bool VariantTreeModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (parent.column() > 0)
+        return false;
+
+    VariantTreeItem* parentItem = This::item(parent);
+    return parentItem->canFetchMore();
+}
+
+void VariantTreeModel::fetchMore(const QModelIndex& parent)
+{
+    if (parent.column() > 0)
+        return;
+
+    VariantTreeItem* parentItem = This::item(parent);
+    if (!parentItem->canFetchMore())
+        return;
+
+    m_fetching = true;
+    beginInsert(parent, 0, parentItem->valueCount() - 1);
+    parentItem->fetchMore();
+    endInsert();
+    m_fetching = false;
+}
+
+QStringList VariantTreeModel::mimeTypes() const
+{
+    QStringList types;
+    types << VariantTreeMimeData::nodesMimeType()
+          << VariantTreeMimeData::jsonMimeType()
+          << QStringLiteral("text/plain");
+    return types;
+}
+
 QMimeData* VariantTreeModel::mimeData(const QModelIndexList& indexes) const
 {
-    //TODO: implement drag&drop
+    QModelIndexList nodes = topIndexes(indexes);
+    if (nodes.isEmpty())
+        return nullptr;
 
-    //if (indexes.count() > 0)
-    //    return Base::mimeData(indexes);
-    QModelIndex idx = indexes.at(0);
-    VariantTreeItem* item = castItemFromIndex(idx);
+    return new VariantTreeMimeData(this, nodes);
+}
+
+bool VariantTreeModel::dropMimeData(const QMimeData* data, Qt::DropAction action, int row, int column, const QModelIndex& parent)
+{
+    Q_UNUSED(column)
+
+    if (action == Qt::IgnoreAction)
+        return true;
 
-    Q_UNUSED(item)
+    // a drop onto a scalar goes next to it
+    QModelIndex dst = parent.sibling(parent.row(), 0);
+    if (dst.isValid() && castItemFromIndex(dst)->isPlain()) {
+        row = dst.row() + 1;
+        dst = dst.parent();
+    }
 
-    QString url;
-    url += QString::number(idx.row()) + "/";
-    while (idx.isValid()) {
-        idx = idx.parent();
-        url += QString::number(idx.row()) + "/";
+    const VariantTreeMimeData* nodes = qobject_cast<const VariantTreeMimeData*>(data);
+    if (nodes && nodes->model() == this && action == Qt::MoveAction) {
+        moveIndexes(nodes->indexes(), dst, row);
+        // the rows are moved already, a refused drop
+        // keeps the view from removing the sources
+        return false;
     }
 
-    return Base::mimeData(indexes);
+    // other models of this process share the values as well
+    return paste(data, dst, row);
 }
 
-bool VariantTreeModel::dropMimeData(const QMimeData* data, Qt::DropAction action, int row, int column, const QModelIndex& parent)
+QMimeData* VariantTreeModel::copyIndexes(const QModelIndexList& indexes) const
+{
+    QModelIndexList nodes = topIndexes(indexes);
+    if (nodes.isEmpty())
+        return nullptr;
+
+    return new VariantTreeMimeData(this, nodes, false);
+}
+
+bool VariantTreeModel::paste(const QMimeData* data, const QModelIndex& parent, int row)
 {
-    return Base::dropMimeData(data, action, row, column, parent);
+    if (!data)
+        return false;
+
+    // pasting onto a scalar goes next to it
+    QModelIndex dst = parent.sibling(parent.row(), 0);
+    if (dst.isValid() && castItemFromIndex(dst)->isPlain()) {
+        row = dst.row() + 1;
+        dst = dst.parent();
+    }
+
+    const VariantTreeMimeData* nodes = qobject_cast<const VariantTreeMimeData*>(data);
+    if (nodes)
+        return pasteValues(dst, row, nodes->values(), nodes->keys());
+
+    QByteArray json = data->data(VariantTreeMimeData::jsonMimeType());
+    if (json.isEmpty())
+        json = data->text().toUtf8();
+    if (json.isEmpty())
+        return false;
+
+    QVariant value;
+    JsonReader reader(json.constData(), json.size());
+    if (!reader.read(value)) {
+        m_errorString = reader.errorString();
+        return false;
+    }
+
+    return pasteValues(dst, row, QVariantList() << value);
 }
 
 Qt::DropActions VariantTreeModel::supportedDropActions() const
@@ -379,6 +934,7 @@ bool VariantTreeModel::insertRows(int row, int count, const QVariant& value, con
         return false;
 
     VariantTreeItem* item = This::item(parent);
+    fetch(parent);
 
     if (row < 0)
         return false;
@@ -390,16 +946,23 @@ bool VariantTreeModel::insertRows(int row, int count, const QVariant& value, con
 
     if (item->isArray()) {
         if (count > 0) {
-            beginInsertRows(parent, row, row + count - 1);
+            QVariantList values;
+            values.reserve(count);
             for (int i = 0; i < count; i++)
-                item->insertChild(row + i, value);
-            endInsertRows();
+                values.append(value);
+
+            insertValues(parent, row, values);
+
+            QVector<int> parentPath = path(parent);
+            recordUndo([this, parentPath, row, count]() {
+                removeRows(row, count, indexForPath(parentPath));
+            }, [this, parentPath, row, values]() {
+                insertValues(indexForPath(parentPath), row, values);
+            });
         }
 
         return true;
     } else if (item->isObject()) {
-        int attempt = 0;
-        bool insertOk;
         QString key;
 
         if (row > 0) {
@@ -407,35 +970,36 @@ bool VariantTreeModel::insertRows(int row, int count, const QVariant& value, con
             key.remove(QRegularExpression("\\d+$"));
         }
 
-        auto func = [this, &parent, &insertOk](int to) {
-            if (to < 0) {
-                insertOk = false;
-            } else {
-                beginInsertRows(parent, to, to);
-                insertOk = true;
-            }
-
-            return insertOk;
-        };
-
-        while (count) {
-            QString name;
-            if (row > 0)
-                name = key + QString::number(attempt);
-            else
-                name = QString::number(attempt);
+        // all free names are generated at once and inserted
+        // with one notification per contiguous run of rows
+        QStringList keys = item->freeChildKeys(key, count);
+        std::sort(keys.begin(), keys.end());
+        QVector<int> rows = item->newChildRows(keys);
 
-            item->insertChild(name, func, value);
+        beginTransaction();
+        int first = 0;
+        while (first < keys.count()) {
+            int last = first;
+            while (last + 1 < keys.count() && rows[last + 1] == rows[last] + 1)
+                last++;
 
-            if (insertOk) {
-                endInsertRows();
-                count--;
-            }
+            beginInsert(parent, rows[first], rows[last]);
+            item->insertChilds(rows[first], keys.mid(first, last - first + 1), value);
+            endInsert();
 
-            attempt++;
-            if (attempt < 0)
-                break;
+            first = last + 1;
         }
+        commit();
+
+        QVector<int> parentPath = path(parent);
+        recordUndo([this, parentPath, keys]() {
+            takeMembers(indexForPath(parentPath), keys);
+        }, [this, parentPath, keys, value]() {
+            QVariantList values;
+            for (int i = 0; i < keys.count(); i++)
+                values.append(value);
+            insertMembers(indexForPath(parentPath), keys, values);
+        });
 
         return true;
     } else
@@ -445,6 +1009,79 @@ bool VariantTreeModel::insertRows(int row, int count, const QVariant& value, con
 }
 
 bool VariantTreeModel::moveRows(const QModelIndex& sourceParent, int sourceRow, int count, const QModelIndex& destinationParent, int destinationChild)
+{
+    VariantTreeItem* srcParentItem = This::item(sourceParent);
+    VariantTreeItem* dstParentItem = This::item(destinationParent);
+    fetch(sourceParent);
+    fetch(destinationParent);
+
+    // moved items survive the move, their new place is read back from them
+    QList<VariantTreeItem*> movedItems;
+    QStringList sourceKeys;
+    for (int i = 0; i < count && sourceRow >= 0 && sourceRow + i < srcParentItem->childCount(); i++) {
+        movedItems.append(srcParentItem->child(sourceRow + i));
+        if (srcParentItem->isObject())
+            sourceKeys.append(srcParentItem->childKey(sourceRow + i));
+    }
+
+    QVector<int> sourcePath = path(sourceParent);
+    QVector<int> destinationPath = path(destinationParent);
+
+    if (!moveChildRows(sourceParent, sourceRow, count, destinationParent, destinationChild))
+        return false;
+
+    // a partially failed object move leaves some items behind
+    int movedCount = 0;
+    while (movedCount < movedItems.count() && movedItems[movedCount]->parent() == dstParentItem)
+        movedCount++;
+
+    if (movedCount == 0)
+        return true;
+
+    auto redo = [this, sourcePath, sourceRow, count, destinationPath, destinationChild]() {
+        moveRows(indexForPath(sourcePath), sourceRow, count, indexForPath(destinationPath), destinationChild);
+    };
+
+    if (srcParentItem == dstParentItem && dstParentItem->isArray()) {
+        int newRow = destinationChild > sourceRow ? destinationChild - count : destinationChild;
+        int oldRow = newRow < sourceRow ? sourceRow + count : sourceRow;
+        recordUndo([this, sourcePath, newRow, count, oldRow]() {
+            QModelIndex parent = indexForPath(sourcePath);
+            moveRows(parent, newRow, count, parent, oldRow);
+        }, redo);
+        return true;
+    }
+
+    // other moves are undone by taking the values out of the destination
+    // and putting them back in place, the source path is valid again then
+    bool sourceIsArray = srcParentItem->isArray();
+    bool destinationIsArray = dstParentItem->isArray();
+    QVector<int> movedPath = path(indexForItem(dstParentItem));
+    int movedRow = movedItems.first()->row();
+    QStringList movedKeys;
+    if (!destinationIsArray) {
+        for (int i = 0; i < movedCount; i++)
+            movedKeys.append(movedItems[i]->key());
+    }
+    sourceKeys = sourceKeys.mid(0, movedCount);
+
+    recordUndo([this, movedPath, movedRow, movedKeys, movedCount, destinationIsArray,
+               sourcePath, sourceRow, sourceKeys, sourceIsArray]() {
+        QModelIndex destination = indexForPath(movedPath);
+        QVariantList values = destinationIsArray ? takeRows(destination, movedRow, movedCount)
+                                                 : takeMembers(destination, movedKeys);
+
+        QModelIndex source = indexForPath(sourcePath);
+        if (sourceIsArray)
+            insertValues(source, sourceRow, values);
+        else
+            insertMembers(source, sourceKeys, values);
+    }, redo);
+
+    return true;
+}
+
+bool VariantTreeModel::moveChildRows(const QModelIndex& sourceParent, int sourceRow, int count, const QModelIndex& destinationParent, int destinationChild)
 {
     if (count < 0)
         return false;
@@ -459,10 +1096,12 @@ bool VariantTreeModel::moveRows(const QModelIndex& sourceParent, int sourceRow,
 
     VariantTreeItem* srcParentItem = This::item(sourceParent);
     VariantTreeItem* dstParentItem = This::item(destinationParent);
+    fetch(sourceParent);
+    fetch(destinationParent);
 
     if (sourceRow < 0)
         return false;
-    if (sourceRow >= srcParentItem->childCount())
+    if (sourceRow + count > srcParentItem->childCount())
         return false;
 
     if (destinationChild < 0)
@@ -474,43 +1113,81 @@ bool VariantTreeModel::moveRows(const QModelIndex& sourceParent, int sourceRow,
 
     if (dstParentItem->isArray()) {
         if (count > 0) {
-            mvOk = beginMoveRows(sourceParent, sourceRow, sourceRow + count - 1, destinationParent, destinationChild);
+            mvOk = beginMove(sourceParent, sourceRow, sourceRow + count - 1, destinationParent, destinationChild);
             if (!mvOk)
                 return false;
 
-            int correctRow = sourceParent == destinationParent ? destinationChild > sourceRow ? 1 : 0 : 0;
-            for (int i = 0; i < count; i++)
-                srcParentItem->moveChild(sourceRow, dstParentItem, destinationChild + i - correctRow);
-            endMoveRows();
+            srcParentItem->moveChilds(sourceRow, count, dstParentItem, destinationChild);
+            endMove();
         }
 
         return true;
-    } else if (dstParentItem->isObject()) {
-        auto func = [this, &sourceParent, &sourceRow, &count, &destinationParent, &mvOk](int to) {
-            mvOk = to < 0 ? false : beginMoveRows(sourceParent, sourceRow, sourceRow, destinationParent, to);
-            return mvOk;
-        };
+    } else if (dstParentItem->isObject() && srcParentItem != dstParentItem) {
+        if (count == 0)
+            return true;
 
+        // array items are named by their destination row,
+        // object members keep their keys unless they are taken
+        QStringList keys;
         if (srcParentItem->isArray()) {
-            while (count) {
-                srcParentItem->moveChild(sourceRow, dstParentItem, QString::number(destinationChild), func);
+            keys = dstParentItem->freeChildKeys(QString(), count, destinationChild);
+        } else {
+            QStringList wantedKeys;
+            for (int i = 0; i < count; i++)
+                wantedKeys.append(srcParentItem->childKey(sourceRow + i));
+            keys = dstParentItem->freeChildKeys(wantedKeys);
+        }
 
-                if (mvOk) {
-                    endMoveRows();
-                    count--;
-                }
+        if (keys.count() < count)
+            return false;
 
-                destinationChild++;
-                if (destinationChild < 0)
-                    break;
-            }
+        QStringList sortedKeys = keys;
+        std::sort(sortedKeys.begin(), sortedKeys.end());
+        QVector<int> sortedRows = dstParentItem->newChildRows(sortedKeys);
+
+        QHash<QString, int> rowByKey;
+        rowByKey.reserve(count);
+        for (int i = 0; i < count; i++)
+            rowByKey.insert(sortedKeys[i], sortedRows[i]);
+
+        // one move per run of source rows landing next to each other
+        beginTransaction();
+        int runCount = 0;
+        int first = 0;
+        while (first < count) {
+            int last = first;
+            while (last + 1 < count && rowByKey.value(keys[last + 1]) == rowByKey.value(keys[last]) + 1)
+                last++;
+
+            int runSize = last - first + 1;
+            auto func = [this, &sourceParent, sourceRow, runSize, &destinationParent, &mvOk](int to) {
+                mvOk = beginMove(sourceParent, sourceRow, sourceRow + runSize - 1, destinationParent, to);
+                return mvOk;
+            };
+
+            srcParentItem->moveChilds(sourceRow, keys.mid(first, runSize), dstParentItem, func);
+            if (!mvOk)
+                break;
 
-            return true;
-        } else if (srcParentItem->isObject()) {
+            endMove();
+            runCount++;
+            first = last + 1;
+        }
+        commit();
+
+        return runCount > 0;
+    } else if (dstParentItem->isObject()) {
+        // moving inside one object renames the members
+        auto func = [this, &sourceParent, &sourceRow, &count, &destinationParent, &mvOk](int to) {
+            mvOk = to < 0 ? false : beginMove(sourceParent, sourceRow, sourceRow, destinationParent, to);
+            return mvOk;
+        };
+
+        if (srcParentItem->isObject()) {
             for (int i = 0; i < count; i++) {
                 QString key;
 
-                if (destinationChild < 0)
+                if (destinationChild >= dstParentItem->childCount())
                     key = srcParentItem->childKey(sourceRow);
                 else
                     key = dstParentItem->childKey(destinationChild);
@@ -528,7 +1205,7 @@ bool VariantTreeModel::moveRows(const QModelIndex& sourceParent, int sourceRow,
                     srcParentItem->moveChild(sourceRow, dstParentItem, name, func);
 
                     if (mvOk)
-                        endMoveRows();
+                        endMove();
                     else {
                         attempt++;
                         if (attempt < 0)
@@ -557,20 +1234,42 @@ bool VariantTreeModel::removeRows(int row, int count, const QModelIndex& parent)
         return false;
 
     VariantTreeItem* item = This::item(parent);
+    fetch(parent);
 
     if (count < 0)
         return false;
 
-    if (row < 0 || row >= item->childCount())
+    if (row < 0 || row + count > item->childCount())
         return false;
 
     if (item->isArray() || item->isObject()) {
         if (count > 0) {
-            beginRemoveRows(parent, row, row + count - 1);
-            for (int i = 0; i < count; i++) {
-                item->removeChild(row + i);
+            // removed subtrees stay shared with the undo stack
+            QVariantList values;
+            QStringList keys;
+            if (!m_replaying) {
+                values.reserve(count);
+                for (int i = 0; i < count; i++) {
+                    const VariantTreeItem* child = item->child(row + i);
+                    values.append(child->value());
+                    if (item->isObject())
+                        keys.append(child->key());
+                }
             }
-            endRemoveRows();
+
+            beginRemove(parent, row, row + count - 1);
+            item->removeChilds(row, count);
+            endRemove();
+
+            QVector<int> parentPath = path(parent);
+            recordUndo([this, parentPath, row, values, keys]() {
+                if (keys.isEmpty())
+                    insertValues(indexForPath(parentPath), row, values);
+                else
+                    insertMembers(indexForPath(parentPath), keys, values);
+            }, [this, parentPath, row, count]() {
+                removeRows(row, count, indexForPath(parentPath));
+            });
         }
 
         return true;
@@ -580,6 +1279,94 @@ bool VariantTreeModel::removeRows(int row, int count, const QModelIndex& parent)
     return Base::removeRows(row, count, parent);
 }
 
+void VariantTreeModel::removeIndexes(const QModelIndexList& indexes)
+{
+    QSet<VariantTreeItem*> selected;
+    for (const QModelIndex& index : indexes) {
+        if (index.isValid() && index.model() == this)
+            selected.insert(castItemFromIndex(index));
+    }
+
+    // rows inside a selected subtree go away with their ancestor
+    QHash<VariantTreeItem*, QVector<int>> rowsByParent;
+    for (VariantTreeItem* item : selected) {
+        VariantTreeItem* parentItem = item->parent();
+        bool covered = false;
+
+        for (VariantTreeItem* it = parentItem; it && !covered; it = it->parent())
+            covered = selected.contains(it);
+
+        if (!covered)
+            rowsByParent[parentItem].append(item->row());
+    }
+
+    // removing inside one parent never moves another group's parent
+    // out of existence, so each parent index is resolved when needed
+    beginTransaction();
+    auto it = rowsByParent.begin();
+    auto itEnd = rowsByParent.end();
+    for (; it != itEnd; it++) {
+        QModelIndex parent = indexForItem(it.key());
+        QVector<int>& rows = it.value();
+        std::sort(rows.begin(), rows.end());
+
+        // bottom-up so that the remaining rows keep their numbers
+        int last = rows.count() - 1;
+        while (last >= 0) {
+            int first = last;
+            while (first > 0 && rows[first - 1] == rows[first] - 1)
+                first--;
+
+            removeRows(rows[first], rows[last] - rows[first] + 1, parent);
+            last = first - 1;
+        }
+    }
+    commit();
+}
+
+bool VariantTreeModel::pasteValues(const QModelIndex& parent, int row, const QVariantList& values, const QStringList& keys)
+{
+    VariantTreeItem* item = This::item(parent);
+    fetch(parent);
+
+    if (values.isEmpty())
+        return false;
+
+    QVector<int> parentPath = path(parent);
+
+    if (item->isArray()) {
+        if (row < 0 || row > item->childCount())
+            row = item->childCount();
+
+        insertValues(parent, row, values);
+
+        int count = values.count();
+        recordUndo([this, parentPath, row, count]() {
+            removeRows(row, count, indexForPath(parentPath));
+        }, [this, parentPath, row, values]() {
+            insertValues(indexForPath(parentPath), row, values);
+        });
+        return true;
+    }
+
+    if (item->isObject()) {
+        QStringList newKeys = keys.count() == values.count()
+                ? item->freeChildKeys(keys)
+                : item->freeChildKeys(QString(), values.count());
+
+        insertMembers(parent, newKeys, values);
+
+        recordUndo([this, parentPath, newKeys]() {
+            takeMembers(indexForPath(parentPath), newKeys);
+        }, [this, parentPath, newKeys, values]() {
+            insertMembers(indexForPath(parentPath), newKeys, values);
+        });
+        return true;
+    }
+
+    return false;
+}
+
 bool VariantTreeModel::setChildKey(int row, const QString& key, const QModelIndex& parent)
 {
     VariantTreeItem* item = This::item(parent);
@@ -587,34 +1374,592 @@ bool VariantTreeModel::setChildKey(int row, const QString& key, const QModelInde
     if (!item->isObject())
         return false;
 
-    bool mvOk;
-    item->setChildKey(key, [this, &parent, row, &mvOk](int to) {
-        if (to < 0) {
-            mvOk = false;
-        } else {
-            mvOk = beginMoveRows(parent, row, row, parent, to);
-            return true;
-        }
-        return mvOk;
+    fetch(parent);
+
+    if (row < 0 || row >= item->childCount())
+        return false;
+
+    QString oldKey = item->childKey(row);
+
+    bool renamed = false;
+    bool mvOk = false;
+    int newRow = row;
+    item->setChildKey(key, [this, &parent, row, &renamed, &mvOk, &newRow](int to) {
+        if (to < 0)
+            return false;
+
+        // no move is needed when the key sorts at the same place
+        renamed = true;
+        mvOk = beginMove(parent, row, row, parent, to);
+        newRow = to > row ? to - 1 : to;
+        return true;
     }, row);
 
     if (mvOk)
-        endMoveRows();
-    else
+        endMove();
+
+    if (!renamed)
         return false;
 
+    m_pointerCache.clear();
+    changeData(parent, newRow, newRow);
+
+    if (key != oldKey) {
+        QVector<int> parentPath = path(parent);
+        recordUndo([this, parentPath, newRow, oldKey]() {
+            setChildKey(newRow, oldKey, indexForPath(parentPath));
+        }, [this, parentPath, row, key]() {
+            setChildKey(row, key, indexForPath(parentPath));
+        });
+    }
+
     return true;
 }
 
 void VariantTreeModel::setValue(const QVariant& value, const QModelIndex& index)
 {
-    VariantTreeItem* item = static_cast<VariantTreeItem*>(index.internalPointer());
+    if (!index.isValid() || !VariantTreeItem::checkValue(value))
+        return;
+
+    VariantTreeItem* item = castItemFromIndex(index);
+    QVariant oldValue = item->value();
+
+    replaceValue(index, value);
+
+    QVector<int> indexPath = path(index);
+    recordUndo([this, indexPath, oldValue]() {
+        replaceValue(indexForPath(indexPath), oldValue);
+    }, [this, indexPath, value]() {
+        replaceValue(indexForPath(indexPath), value);
+    });
+}
+
+// replaces the whole value, the old childs are removed
+void VariantTreeModel::replaceValue(const QModelIndex& index, const QVariant& value)
+{
+    QModelIndex idx = index.sibling(index.row(), 0);
+    VariantTreeItem* item = castItemFromIndex(idx);
+
+    if (item->childCount() > 0) {
+        beginRemove(idx, 0, item->childCount() - 1);
+        item->setValue(value);
+        endRemove();
+    } else {
+        item->setValue(value);
+    }
+
+    changeData(idx.parent(), idx.row(), idx.row());
+}
+
+// one node after the other, each in front of the row the drop
+// pointed at, all as one undo step
+void VariantTreeModel::moveIndexes(const QModelIndexList& indexes, const QModelIndex& parent, int row)
+{
+    fetch(parent);
+
+    QPersistentModelIndex dst(parent);
+    QPersistentModelIndex anchor;
+    if (row >= 0 && row < rowCount(parent))
+        anchor = index(row, 0, parent);
+
+    QList<QPersistentModelIndex> handles;
+    for (const QModelIndex& idx : indexes)
+        handles.append(idx);
+
+    beginTransaction();
+    for (const QPersistentModelIndex& handle : handles) {
+        if (!handle.isValid() || handle == anchor)
+            continue;
+
+        // a node cannot go into its own subtree
+        bool inside = false;
+        for (QModelIndex it = dst; it.isValid() && !inside; it = it.parent())
+            inside = it == handle;
+        if (inside)
+            continue;
+
+        int dstRow = anchor.isValid() ? anchor.row() : rowCount(dst);
+        moveRows(handle.parent(), handle.row(), 1, dst, dstRow);
+    }
+    commit();
+}
+
+QModelIndexList VariantTreeModel::topIndexes(const QModelIndexList& indexes) const
+{
+    QSet<VariantTreeItem*> selected;
+    for (const QModelIndex& index : indexes) {
+        if (index.isValid() && index.model() == this)
+            selected.insert(castItemFromIndex(index));
+    }
+
+    QMap<QVector<int>, QModelIndex> nodes;
+    for (VariantTreeItem* item : selected) {
+        bool covered = false;
+        for (VariantTreeItem* it = item->parent(); it && !covered; it = it->parent())
+            covered = selected.contains(it);
+
+        if (!covered) {
+            QModelIndex index = indexForItem(item);
+            nodes.insert(path(index), index);
+        }
+    }
+
+    return nodes.values();
+}
+
+// undo support
+// @@@@@@@@@@@@
+
+bool VariantTreeModel::canUndo() const
+{
+    return !m_undoStack.isEmpty();
+}
+
+bool VariantTreeModel::canRedo() const
+{
+    return !m_redoStack.isEmpty();
+}
+
+void VariantTreeModel::undo()
+{
+    if (m_undoStack.isEmpty() || inTransaction())
+        return;
+
+    UndoGroup group = m_undoStack.takeLast();
+
+    // a bulk edit is replayed as one batched update
+    m_replaying = true;
+    beginTransaction();
+    for (int i = group.count() - 1; i >= 0; i--)
+        group[i].undo();
+    commit();
+    m_replaying = false;
+
+    m_redoStack.append(group);
+    emit undoStackChanged();
+}
+
+void VariantTreeModel::redo()
+{
+    if (m_redoStack.isEmpty() || inTransaction())
+        return;
+
+    UndoGroup group = m_redoStack.takeLast();
+
+    m_replaying = true;
+    beginTransaction();
+    for (int i = 0; i < group.count(); i++)
+        group[i].redo();
+    commit();
+    m_replaying = false;
+
+    m_undoStack.append(group);
+    emit undoStackChanged();
+}
+
+void VariantTreeModel::clearUndo()
+{
+    m_undoStack.clear();
+    m_redoStack.clear();
+    m_undoGroup.clear();
+    emit undoStackChanged();
+}
+
+void VariantTreeModel::recordUndo(const std::function<void()>& undo, const std::function<void()>& redo)
+{
+    if (m_replaying)
+        return;
+
+    UndoCommand command;
+    command.undo = undo;
+    command.redo = redo;
+    m_undoGroup.append(command);
+
+    // edits of a transaction are undone together
+    if (m_transactionDepth == 0)
+        pushUndoGroup();
+}
+
+void VariantTreeModel::pushUndoGroup()
+{
+    if (m_undoGroup.isEmpty())
+        return;
+
+    m_undoStack.append(m_undoGroup);
+    m_undoGroup.clear();
+    m_redoStack.clear();
+    emit undoStackChanged();
+}
+
+QVector<int> VariantTreeModel::path(const QModelIndex& index) const
+{
+    QVector<int> rows;
+    for (QModelIndex it = index; it.isValid(); it = it.parent())
+        rows.prepend(it.row());
+    return rows;
+}
+
+QModelIndex VariantTreeModel::indexForPath(const QVector<int>& path)
+{
+    QModelIndex index;
+    for (int row : path) {
+        fetch(index);
+        index = This::index(row, 0, index);
+    }
+    return index;
+}
+
+QModelIndex VariantTreeModel::indexForTokens(const QStringList& tokens)
+{
+    QModelIndex index;
+    for (const QString& token : tokens) {
+        fetch(index);
+
+        const VariantTreeItem* parentItem = item(index);
+        int row = -1;
+        if (parentItem->isObject())
+            row = parentItem->childRow(token);
+        else if (parentItem->isArray())
+            row = JsonPointer::arrayIndex(token);
+
+        if (row < 0 || row >= parentItem->childCount())
+            return QModelIndex();
+
+        index = This::index(row, 0, index);
+    }
+    return index;
+}
+
+QString VariantTreeModel::pointer(const QModelIndex& index) const
+{
+    QStringList tokens;
+
+    for (const VariantTreeItem* it = item(index); it->hasParent(); it = it->parent()) {
+        if (it->parent()->isArray())
+            tokens.prepend(QString::number(it->row()));
+        else
+            tokens.prepend(it->key());
+    }
+
+    return JsonPointer::join(tokens);
+}
+
+QModelIndex VariantTreeModel::indexForPointer(const QString& pointer)
+{
+    if (const QModelIndex* cached = m_pointerCache.object(pointer))
+        return *cached;
+
+    QStringList tokens;
+    if (!JsonPointer::parse(pointer, &tokens))
+        return QModelIndex();
+
+    QModelIndex index = indexForTokens(tokens);
+    if (index.isValid())
+        m_pointerCache.insert(pointer, new QModelIndex(index));
+
+    return index;
+}
+
+QModelIndexList VariantTreeModel::indexesForQuery(const JsonQuery& query)
+{
+    QModelIndexList indexes;
+
+    for (const JsonQuery::Match& match : query.evaluate(m_variantTree)) {
+        // the root itself has no index
+        QModelIndex index = indexForTokens(match.tokens());
+        if (index.isValid())
+            indexes.append(index);
+    }
+
+    return indexes;
+}
+
+void VariantTreeModel::insertValues(const QModelIndex& parent, int row, const QVariantList& values)
+{
+    VariantTreeItem* item = This::item(parent);
+    fetch(parent);
+
+    if (values.isEmpty())
+        return;
+
+    beginInsert(parent, row, row + values.count() - 1);
+    item->insertChilds(row, values);
+    endInsert();
+}
+
+void VariantTreeModel::insertMembers(const QModelIndex& parent, const QStringList& keys, const QVariantList& values)
+{
+    VariantTreeItem* item = This::item(parent);
+    fetch(parent);
+
+    QVariantMap members;
+    for (int i = 0; i < keys.count(); i++)
+        members.insert(keys[i], values[i]);
+
+    QStringList sortedKeys = members.keys();
+    QVariantList sortedValues = members.values();
+    QVector<int> rows = item->newChildRows(sortedKeys);
+
+    beginTransaction();
+    int first = 0;
+    while (first < sortedKeys.count()) {
+        int last = first;
+        while (last + 1 < sortedKeys.count() && rows[last + 1] == rows[last] + 1)
+            last++;
+
+        int runSize = last - first + 1;
+        beginInsert(parent, rows[first], rows[last]);
+        item->insertChilds(rows[first], sortedKeys.mid(first, runSize), sortedValues.mid(first, runSize));
+        endInsert();
+
+        first = last + 1;
+    }
+    commit();
+}
+
+QVariantList VariantTreeModel::takeRows(const QModelIndex& parent, int row, int count)
+{
+    VariantTreeItem* item = This::item(parent);
+    fetch(parent);
+
+    QVariantList values = item->arrayValue().mid(row, count);
+    removeRows(row, count, parent);
+    return values;
+}
+
+QVariantList VariantTreeModel::takeMembers(const QModelIndex& parent, const QStringList& keys)
+{
+    VariantTreeItem* item = This::item(parent);
+    fetch(parent);
+
+    QVariantList values;
+    QVector<int> rows;
+    for (const QString& key : keys) {
+        int row = item->childRow(key);
+        values.append(item->child(row)->value());
+        rows.append(row);
+    }
+    std::sort(rows.begin(), rows.end());
+
+    beginTransaction();
+    int last = rows.count() - 1;
+    while (last >= 0) {
+        int first = last;
+        while (first > 0 && rows[first - 1] == rows[first] - 1)
+            first--;
+
+        removeRows(rows[first], rows[last] - rows[first] + 1, parent);
+        last = first - 1;
+    }
+    commit();
+
+    return values;
+}
+
+void VariantTreeModel::fetch(const QModelIndex& parent)
+{
+    if (canFetchMore(parent))
+        fetchMore(parent);
+}
+
+// transactions
+// @@@@@@@@@@@@
+
+void VariantTreeModel::beginTransaction()
+{
+    if (m_transactionDepth++ == 0)
+        m_transactionEdits = 0;
+}
+
+void VariantTreeModel::commit()
+{
+    Q_ASSERT(m_transactionDepth > 0);
+
+    if (--m_transactionDepth == 0) {
+        publish();
+        pushUndoGroup();
+    }
+}
 
-    // TODO:
-    //item->setValue(value);
+void VariantTreeModel::publish()
+{
+    if (m_layoutChanging) {
+        QModelIndexList newIndexes;
+        newIndexes.reserve(m_layoutIndexes.count());
+
+        for (int i = 0; i < m_layoutIndexes.count(); i++) {
+            VariantTreeItem* item = m_layoutItems[i];
+            if (item)
+                newIndexes.append(createIndex(item->row(), m_layoutIndexes[i].column(), item));
+            else
+                newIndexes.append(QModelIndex());
+        }
+
+        changePersistentIndexList(m_layoutIndexes, newIndexes);
+        m_layoutIndexes.clear();
+        m_layoutItems.clear();
+        m_layoutChanging = false;
+
+        emit layoutChanged();
+        return;
+    }
+
+    QList<PendingData> pendingData;
+    pendingData.swap(m_pendingData);
+
+    for (const PendingData& pending : pendingData) {
+        if (!pending.root && !pending.parent.isValid())
+            continue;
+
+        QModelIndex parent = pending.parent;
+        int last = qMin(pending.last, rowCount(parent) - 1);
+        if (pending.first > last)
+            continue;
+
+        emit dataChanged(index(pending.first, 0, parent), index(last, columnCount(parent) - 1, parent));
+    }
+}
+
+void VariantTreeModel::structureChanged(const QModelIndex& parent)
+{
+    // fetched rows existed before, their pointers stay the same
+    if (!m_fetching)
+        m_pointerCache.clear();
+
+    if (m_transactionDepth == 0 || m_layoutChanging)
+        return;
+
+    // rows of this parent may have shifted under pending data changes
+    for (PendingData& pending : m_pendingData) {
+        if (pending.root ? !parent.isValid() : pending.parent == parent) {
+            pending.first = 0;
+            pending.last = INT_MAX;
+        }
+    }
+
+    if (++m_transactionEdits > LayoutChangeThreshold)
+        beginLayoutChange();
+}
+
+void VariantTreeModel::beginLayoutChange()
+{
+    emit layoutAboutToBeChanged();
+
+    // repainting covers all data changes
+    m_pendingData.clear();
+
+    m_layoutIndexes = persistentIndexList();
+    m_layoutItems.clear();
+    m_layoutItems.reserve(m_layoutIndexes.count());
+    for (const QModelIndex& index : m_layoutIndexes)
+        m_layoutItems.append(castItemFromIndex(index));
+
+    m_layoutChanging = true;
+}
+
+void VariantTreeModel::beginInsert(const QModelIndex& parent, int first, int last)
+{
+    structureChanged(parent);
+    if (!m_layoutChanging)
+        beginInsertRows(parent, first, last);
+}
+
+void VariantTreeModel::endInsert()
+{
+    if (!m_layoutChanging)
+        endInsertRows();
+}
+
+void VariantTreeModel::beginRemove(const QModelIndex& parent, int first, int last)
+{
+    structureChanged(parent);
+    if (!m_layoutChanging) {
+        beginRemoveRows(parent, first, last);
+        return;
+    }
+
+    // forget tracked items inside the removed subtrees
+    VariantTreeItem* parentItem = item(parent);
+    for (VariantTreeItem*& tracked : m_layoutItems) {
+        for (VariantTreeItem* it = tracked; it && it->hasParent(); it = it->parent()) {
+            if (it->parent() == parentItem) {
+                if (it->row() >= first && it->row() <= last)
+                    tracked = nullptr;
+                break;
+            }
+        }
+    }
+}
+
+void VariantTreeModel::endRemove()
+{
+    if (!m_layoutChanging)
+        endRemoveRows();
+}
+
+bool VariantTreeModel::beginMove(const QModelIndex& sourceParent, int sourceFirst, int sourceLast, const QModelIndex& destinationParent, int destinationChild)
+{
+    structureChanged(sourceParent);
+    if (sourceParent != destinationParent)
+        structureChanged(destinationParent);
+
+    if (!m_layoutChanging)
+        return beginMoveRows(sourceParent, sourceFirst, sourceLast, destinationParent, destinationChild);
+
+    // same checks as beginMoveRows()
+    VariantTreeItem* srcParentItem = item(sourceParent);
+    VariantTreeItem* dstParentItem = item(destinationParent);
+
+    if (srcParentItem == dstParentItem)
+        return destinationChild < sourceFirst || destinationChild > sourceLast + 1;
+
+    for (VariantTreeItem* it = dstParentItem; it && it->hasParent(); it = it->parent()) {
+        if (it->parent() == srcParentItem && it->row() >= sourceFirst && it->row() <= sourceLast)
+            return false;
+    }
+
+    return true;
+}
+
+void VariantTreeModel::endMove()
+{
+    if (!m_layoutChanging)
+        endMoveRows();
+}
+
+void VariantTreeModel::changeData(const QModelIndex& parent, int first, int last)
+{
+    if (m_transactionDepth == 0) {
+        emit dataChanged(index(first, 0, parent), index(last, columnCount(parent) - 1, parent));
+        return;
+    }
+
+    if (m_layoutChanging)
+        return;
+
+    bool root = !parent.isValid();
+    for (PendingData& pending : m_pendingData) {
+        if (pending.root == root && (root || pending.parent == parent)) {
+            pending.first = qMin(pending.first, first);
+            pending.last = qMax(pending.last, last);
+            return;
+        }
+    }
+
+    PendingData pending;
+    pending.parent = parent;
+    pending.root = root;
+    pending.first = first;
+    pending.last = last;
+    m_pendingData.append(pending);
+}
+
+QModelIndex VariantTreeModel::indexForItem(VariantTreeItem* item) const
+{
+    if (item == m_rootItem)
+        return QModelIndex();
 
-    Q_UNUSED(item);
-    Q_UNUSED(value);
+    return createIndex(item->row(), 0, item);
 }
 
 VariantTreeItem* VariantTreeModel::item(const QModelIndex& index) const
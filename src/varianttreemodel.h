@@ -1,10 +1,20 @@
 #ifndef VARIANTTREEMODEL_H
 #define VARIANTTREEMODEL_H
 
+#include <functional>
+
 #include <QAbstractItemModel>
+#include <QAtomicInt>
+#include <QCache>
+#include <QFutureWatcher>
+#include <QPersistentModelIndex>
+#include <QVector>
 #include <QJsonValue>
 
+#include "jsonquery.h"
+#include "jsonwriter.h"
 #include "varianttreeitem.h"
+#include "varianttreeitempool.h"
 
 class QIODevice;
 
@@ -17,6 +27,7 @@ class VariantTreeModel : public QAbstractItemModel
 
 public:
     enum AdditionalRoles {
+        // RFC 6901 JSON Pointer of the node
         UrlRole = Qt::UserRole
     };
 
@@ -26,15 +37,62 @@ public:
         TypeColumn = 2
     };
 
+    // file formats, chosen by the file name suffix
+    enum DocumentFormat {
+        Json,
+        Yaml,
+        Cbor,
+        MessagePack
+    };
+
     explicit VariantTreeModel(QObject* parent = Q_NULLPTR);
     ~VariantTreeModel();
 
+    static DocumentFormat formatForFileName(const QString& fileName);
+
+    // format of the loaded document, a YAML stream or a CBOR/MessagePack
+    // sequence of several documents is held as an array of them
+    DocumentFormat documentFormat() const
+    { return m_documentFormat; }
+    bool isMultiDocument() const
+    { return m_multiDocument; }
+
     bool load(const QString& fileName);
-    bool load(QIODevice* device);
+    bool load(QIODevice* device, DocumentFormat format = Json);
     bool loadJson(const QByteArray& json);
+    bool loadJson(const char* data, qint64 size);
     bool loadVariantTree(const QVariant& v);
     void destroy();
 
+    // background loading, the tree is swapped in when parsing is done
+    bool loadAsync(const QString& fileName);
+    bool isLoading() const;
+
+    // large top-level arrays are parsed on all cores
+    void setParallelLoad(bool enabled)
+    { m_parallelLoad = enabled; }
+    bool parallelLoad() const
+    { return m_parallelLoad; }
+
+    bool save(const QString& fileName, JsonWriter::Format format = JsonWriter::Indented);
+    bool save(QIODevice* device, JsonWriter::Format format = JsonWriter::Indented);
+    bool save(QIODevice* device, DocumentFormat documentFormat, JsonWriter::Format format = JsonWriter::Indented);
+
+    // background saving of a shared snapshot, editing may continue meanwhile
+    bool saveAsync(const QString& fileName, JsonWriter::Format format = JsonWriter::Indented);
+    bool isSaving() const;
+
+    // last load or save error
+    const QString& errorString() const
+    { return m_errorString; }
+    qint64 errorOffset() const
+    { return m_errorOffset; }
+    int errorLine() const
+    { return m_errorLine; }
+    // the last load could not open or read its input
+    bool isIoError() const
+    { return m_ioError; }
+
     Qt::ItemFlags flags(const QModelIndex& index) const;
 
     QVariant data(const QModelIndex& index, int role) const;
@@ -47,7 +105,16 @@ public:
     int rowCount(const QModelIndex& parent = QModelIndex()) const;
     int columnCount(const QModelIndex& parent = QModelIndex()) const;
 
+    bool hasChildren(const QModelIndex& parent = QModelIndex()) const;
+    bool canFetchMore(const QModelIndex& parent) const;
+    void fetchMore(const QModelIndex& parent);
+    // rows inserted now are existing data being expanded
+    bool isFetching() const
+    { return m_fetching; }
+
+    QStringList mimeTypes() const;
     QMimeData* mimeData(const QModelIndexList& indexes) const;
+    // nodes dragged inside the model are moved, other drops insert the values
     bool dropMimeData(const QMimeData* data, Qt::DropAction action, int row, int column, const QModelIndex& parent);
 
     void setIcon(const QJsonValue::Type& type, const QIcon& icon);
@@ -60,9 +127,44 @@ public:
     bool moveRows(const QModelIndex& sourceParent, int sourceRow, int count, const QModelIndex& destinationParent, int destinationChild);
     bool removeRows(int row, int count, const QModelIndex& parent = QModelIndex());
 
+    // removes a whole selection, grouped into row ranges per parent
+    void removeIndexes(const QModelIndexList& indexes);
+
+    // clipboard snapshot of the selection, owned by the caller
+    QMimeData* copyIndexes(const QModelIndexList& indexes) const;
+    // shares values copied in this process, parses JSON text otherwise
+    bool paste(const QMimeData* data, const QModelIndex& parent, int row = -1);
+
+    // inserts shared values before row, or appended for row -1; object
+    // members keep their keys where free, array items get generated ones
+    bool pasteValues(const QModelIndex& parent, int row, const QVariantList& values, const QStringList& keys = QStringList());
+
+    // edits until the matching commit() are published together,
+    // long batches as one layout change instead of per-row signals
+    void beginTransaction();
+    void commit();
+    bool inTransaction() const
+    { return m_transactionDepth > 0; }
+
     bool setChildKey(int row, const QString& key, const QModelIndex& parent = QModelIndex());
     void setValue(const QVariant& value, const QModelIndex& index);
 
+    // undo history, removed and replaced subtrees are kept implicitly shared
+    bool canUndo() const;
+    bool canRedo() const;
+
+    // rows from the root down to the index
+    QVector<int> path(const QModelIndex& index) const;
+    QModelIndex indexForPath(const QVector<int>& path);
+    // reference tokens as in JsonQuery::Match, members are looked up by key
+    QModelIndex indexForTokens(const QStringList& tokens);
+    // matches of the query below the root, for bulk selection
+    QModelIndexList indexesForQuery(const JsonQuery& query);
+
+    QString pointer(const QModelIndex& index) const;
+    // recent pointers are cached until the next structural edit
+    QModelIndex indexForPointer(const QString& pointer);
+
     VariantTreeItem* item(const QModelIndex& index) const;
 
     const QVariant& variantTree() const
@@ -72,9 +174,150 @@ public:
 
     static VariantTreeItem* castItemFromIndex(const QModelIndex& index)
     { return static_cast<VariantTreeItem*>(index.internalPointer()); }
+
+public slots:
+    void cancelLoad();
+
+    void undo();
+    void redo();
+    void clearUndo();
+
+signals:
+    void loadProgress(qint64 bytesProcessed, qint64 bytesTotal, qint64 nodeCount);
+    void loadFinished(bool success);
+
+    void saveProgress(qint64 bytesWritten);
+    void saveFinished(bool success, qint64 bytesWritten, qint64 elapsedMs);
+
+    void undoStackChanged();
+
+private slots:
+    void loadAsyncFinished();
+    void saveAsyncFinished();
+
 private:
+    using LoadProgressFunc = std::function<bool(qint64, qint64, qint64)>;
+
+    struct LoadResult
+    {
+        QVariant value;
+        QString errorString;
+        qint64 errorOffset = -1;
+        int errorLine = 0;
+        bool ioError = false;
+        DocumentFormat format = Json;
+        bool multiDocument = false;
+        bool success = false;
+    };
+
+    struct UndoCommand
+    {
+        std::function<void()> undo;
+        std::function<void()> redo;
+    };
+    using UndoGroup = QList<UndoCommand>;
+
+    struct PendingData
+    {
+        QPersistentModelIndex parent;
+        bool root;
+        int first;
+        int last;
+    };
+
+    // structural edits passed through before switching to a layout change
+    static const int LayoutChangeThreshold = 64;
+
+    struct SaveResult
+    {
+        QString errorString;
+        qint64 bytesWritten = 0;
+        qint64 elapsedMs = 0;
+        bool success = false;
+    };
+
+    static LoadResult loadFile(const QString& fileName, bool parallel, const LoadProgressFunc& progress);
+    static LoadResult parseDocument(const char* data, qint64 size, DocumentFormat format, bool parallel, const LoadProgressFunc& progress);
+    static LoadResult parseJson(const char* data, qint64 size, bool parallel, const LoadProgressFunc& progress);
+    static LoadResult parseYaml(const char* data, qint64 size, bool parallel, const LoadProgressFunc& progress);
+    template<typename Reader>
+    static LoadResult parseBinary(const char* data, qint64 size, DocumentFormat format, const LoadProgressFunc& progress);
+    bool applyLoadResult(LoadResult& result);
+
+    static SaveResult saveFile(const QString& fileName, const QVariant& value, DocumentFormat documentFormat, bool multiDocument,
+                               JsonWriter::Format format, const JsonWriter::ProgressFunc& progress);
+    static SaveResult writeDocument(QIODevice* device, const QVariant& value, DocumentFormat documentFormat, bool multiDocument,
+                                    JsonWriter::Format format, const JsonWriter::ProgressFunc& progress);
+    template<typename Writer>
+    static SaveResult writeStream(QIODevice* device, const QVariant& value, bool multiDocument,
+                                  const JsonWriter::ProgressFunc& progress);
+
+    void resetVariantTree(QVariant& value);
+    void setError(const QString& error, qint64 offset = -1, int line = 0);
+
+    void fetch(const QModelIndex& parent);
+    bool moveChildRows(const QModelIndex& sourceParent, int sourceRow, int count, const QModelIndex& destinationParent, int destinationChild);
+    void replaceValue(const QModelIndex& index, const QVariant& value);
+
+    void moveIndexes(const QModelIndexList& indexes, const QModelIndex& parent, int row);
+    // selected nodes without those inside another selected subtree, in document order
+    QModelIndexList topIndexes(const QModelIndexList& indexes) const;
+
+    // edit primitives shared with undo
+    void insertValues(const QModelIndex& parent, int row, const QVariantList& values);
+    void insertMembers(const QModelIndex& parent, const QStringList& keys, const QVariantList& values);
+    QVariantList takeRows(const QModelIndex& parent, int row, int count);
+    QVariantList takeMembers(const QModelIndex& parent, const QStringList& keys);
+
+    void recordUndo(const std::function<void()>& undo, const std::function<void()>& redo);
+    void pushUndoGroup();
+
+    // change notifications, coalesced inside transactions
+    void beginInsert(const QModelIndex& parent, int first, int last);
+    void endInsert();
+    void beginRemove(const QModelIndex& parent, int first, int last);
+    void endRemove();
+    bool beginMove(const QModelIndex& sourceParent, int sourceFirst, int sourceLast, const QModelIndex& destinationParent, int destinationChild);
+    void endMove();
+    void changeData(const QModelIndex& parent, int first, int last);
+
+    void structureChanged(const QModelIndex& parent);
+    void beginLayoutChange();
+    void publish();
+    QModelIndex indexForItem(VariantTreeItem* item) const;
+
+    VariantTreeItemPool m_itemPool;
     QVariant m_variantTree;
     VariantTreeItem* m_rootItem;
+
+    QString m_errorString;
+    qint64 m_errorOffset;
+    int m_errorLine;
+    bool m_ioError;
+
+    QFutureWatcher<LoadResult> m_loadWatcher;
+    QAtomicInt m_loadCancel;
+    bool m_parallelLoad;
+
+    QFutureWatcher<SaveResult> m_saveWatcher;
+    bool m_fetching;
+
+    DocumentFormat m_documentFormat;
+    bool m_multiDocument;
+
+    QCache<QString, QModelIndex> m_pointerCache;
+
+    int m_transactionDepth;
+    int m_transactionEdits;
+    bool m_layoutChanging;
+    QModelIndexList m_layoutIndexes;
+    QVector<VariantTreeItem*> m_layoutItems;
+    QList<PendingData> m_pendingData;
+
+    QList<UndoGroup> m_undoStack;
+    QList<UndoGroup> m_redoStack;
+    UndoGroup m_undoGroup;
+    bool m_replaying;
 };
 
 #endif // VARIANTTREEMODEL_H
@@ -1,16 +1,29 @@
 #include <QFileDialog>
+#include <QAction>
+#include <QApplication>
+#include <QClipboard>
+#include <QComboBox>
 #include <QHBoxLayout>
+#include <QItemSelectionModel>
+#include <QLabel>
+#include <QLineEdit>
+#include <QMessageBox>
 #include <QPushButton>
 #include <QTreeView>
 #include <QTextStream>
 
-#include <QJsonDocument>
-
 #include "varianttreewidget.h"
 
 #include "jsondelegate.h"
 #include "yamldelegate.h"
 
+namespace {
+
+// find box mode next to the SearchIndex::MatchMode values
+const int QueryMode = -1;
+
+} // namespace
+
 VariantTreeWidget::VariantTreeWidget(QWidget *parent) : QWidget(parent)
 {
     QVBoxLayout* lt = new QVBoxLayout;
@@ -30,6 +43,11 @@ VariantTreeWidget::VariantTreeWidget(QWidget *parent) : QWidget(parent)
     QPushButton* btnDown = new QPushButton("Down", this);
     QPushButton* btnUp = new QPushButton("Up", this);
 
+    QPushButton* btnUndo = new QPushButton("Undo", this);
+    QPushButton* btnRedo = new QPushButton("Redo", this);
+    m_btnUndo = btnUndo;
+    m_btnRedo = btnRedo;
+
     btnLt->addWidget(btnOpen);
     btnLt->addWidget(btnSaveAs);
     btnLt->addWidget(btnClose);
@@ -42,6 +60,13 @@ VariantTreeWidget::VariantTreeWidget(QWidget *parent) : QWidget(parent)
     btnLt->addWidget(btnDown);
     btnLt->addWidget(btnUp);
 
+    btnLt->addWidget(btnUndo);
+    btnLt->addWidget(btnRedo);
+
+    QLabel* status = new QLabel(this);
+    m_status = status;
+    btnLt->addWidget(status, 1);
+
     btnOpen->setIcon(QIcon::fromTheme("document-open"));
     btnSaveAs->setIcon(QIcon::fromTheme("document-save-as"));
     btnClose->setIcon(QIcon::fromTheme("document-close"));
@@ -53,6 +78,31 @@ VariantTreeWidget::VariantTreeWidget(QWidget *parent) : QWidget(parent)
     btnDown->setIcon(QIcon::fromTheme("go-down-search"));
     btnUp->setIcon(QIcon::fromTheme("go-up-search"));
 
+    btnUndo->setIcon(QIcon::fromTheme("edit-undo"));
+    btnRedo->setIcon(QIcon::fromTheme("edit-redo"));
+    btnUndo->setShortcut(QKeySequence::Undo);
+    btnRedo->setShortcut(QKeySequence::Redo);
+    btnUndo->setEnabled(false);
+    btnRedo->setEnabled(false);
+
+    QHBoxLayout* findLt = new QHBoxLayout;
+    lt->addLayout(findLt);
+
+    QLineEdit* findText = new QLineEdit(this);
+    m_findText = findText;
+    findText->setPlaceholderText("Find keys and values");
+    findText->setClearButtonEnabled(true);
+
+    QComboBox* findMode = new QComboBox(this);
+    m_findMode = findMode;
+    findMode->addItem("Contains", SearchIndex::Substring);
+    findMode->addItem("Starts with", SearchIndex::Prefix);
+    findMode->addItem("Regular expression", SearchIndex::RegularExpression);
+    findMode->addItem("Query", QueryMode);
+
+    findLt->addWidget(findText, 1);
+    findLt->addWidget(findMode);
+
     //@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@
 
     VariantTreeModel* jmod = new VariantTreeModel(this);
@@ -62,6 +112,9 @@ VariantTreeWidget::VariantTreeWidget(QWidget *parent) : QWidget(parent)
     m_jview = jview;
     jview->setModel(jmod);
 
+    SearchIndex* search = new SearchIndex(jmod, this);
+    m_search = search;
+
     jview->setColumnWidth(0, 300);
     jview->setColumnWidth(1, 200);
     jview->setColumnWidth(2, 200);
@@ -72,15 +125,49 @@ VariantTreeWidget::VariantTreeWidget(QWidget *parent) : QWidget(parent)
     jview->setAcceptDrops(true);
     jview->setDropIndicatorShown(true);
 
-    jview->setItemDelegate(new JsonDelegate(m_jview));
+    // the delegate follows the format of the loaded document
+    m_jsonDelegate = new JsonDelegate(jview);
+    m_yamlDelegate = new YamlDelegate(jview);
+    jview->setItemDelegate(m_jsonDelegate);
+
+    QAction* actCopy = new QAction("Copy", jview);
+    QAction* actCut = new QAction("Cut", jview);
+    QAction* actPaste = new QAction("Paste", jview);
+    actCopy->setShortcut(QKeySequence::Copy);
+    actCut->setShortcut(QKeySequence::Cut);
+    actPaste->setShortcut(QKeySequence::Paste);
+    actCopy->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    actCut->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    actPaste->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    jview->addAction(actCopy);
+    jview->addAction(actCut);
+    jview->addAction(actPaste);
+    jview->setContextMenuPolicy(Qt::ActionsContextMenu);
     lt->addWidget(jview);
 
     setLayout(lt);
     lt->setMargin(0);
     btnLt->setMargin(0);
+    findLt->setMargin(0);
+
+    QProgressDialog* progress = new QProgressDialog(this);
+    m_progress = progress;
+    progress->setWindowTitle("Open");
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setRange(0, 1000);
+    progress->setMinimumDuration(500);
+    progress->setAutoReset(false);
+    progress->reset();
 
     connect(jmod, SIGNAL(rowsMoved(const QModelIndex&, int, int, const QModelIndex&, int)), SLOT(rowMoved()));
 
+    connect(jmod, SIGNAL(loadProgress(qint64, qint64, qint64)), SLOT(loadProgress(qint64, qint64, qint64)));
+    connect(jmod, SIGNAL(loadFinished(bool)), SLOT(loadFinished(bool)));
+    connect(progress, SIGNAL(canceled()), jmod, SLOT(cancelLoad()));
+
+    connect(jmod, SIGNAL(saveProgress(qint64)), SLOT(saveProgress(qint64)));
+    connect(jmod, SIGNAL(saveFinished(bool, qint64, qint64)), SLOT(saveFinished(bool, qint64, qint64)));
+
     connect(btnOpen, SIGNAL(clicked(bool)), SLOT(btnOpen_clicked()));
     connect(btnSaveAs, SIGNAL(clicked(bool)), SLOT(btnSaveAs_clicked()));
     connect(btnClose, SIGNAL(clicked(bool)), SLOT(btnClose_clicked()));
@@ -92,6 +179,16 @@ VariantTreeWidget::VariantTreeWidget(QWidget *parent) : QWidget(parent)
 
     connect(btnDown, SIGNAL(clicked(bool)), SLOT(btnDown_clicked()));
     connect(btnUp, SIGNAL(clicked(bool)), SLOT(btnUp_clicked()));
+
+    connect(btnUndo, SIGNAL(clicked(bool)), jmod, SLOT(undo()));
+    connect(btnRedo, SIGNAL(clicked(bool)), jmod, SLOT(redo()));
+    connect(jmod, SIGNAL(undoStackChanged()), SLOT(undoStackChanged()));
+
+    connect(findText, SIGNAL(returnPressed()), SLOT(find()));
+
+    connect(actCopy, SIGNAL(triggered(bool)), SLOT(copy()));
+    connect(actCut, SIGNAL(triggered(bool)), SLOT(cut()));
+    connect(actPaste, SIGNAL(triggered(bool)), SLOT(paste()));
 }
 
 void VariantTreeWidget::rowMoved()
@@ -99,6 +196,135 @@ void VariantTreeWidget::rowMoved()
     QTextStream(stdout) << "moved" << endl;
 }
 
+void VariantTreeWidget::loadProgress(qint64 bytesProcessed, qint64 bytesTotal, qint64 nodeCount)
+{
+    if (!m_jmod->isLoading())
+        return;
+
+    if (bytesTotal > 0)
+        m_progress->setValue(int(bytesProcessed * 1000 / bytesTotal));
+    m_progress->setLabelText(QString("%1 MiB, %2 nodes")
+                             .arg(bytesProcessed >> 20)
+                             .arg(nodeCount));
+}
+
+void VariantTreeWidget::loadFinished(bool success)
+{
+    bool canceled = m_progress->wasCanceled();
+    m_progress->reset();
+
+    if (success)
+        updateDelegate();
+
+    if (!success && !canceled) {
+        QString text = m_jmod->errorString();
+        if (m_jmod->errorOffset() >= 0) {
+            text = QString("%1\nline %2, offset %3")
+                    .arg(text)
+                    .arg(m_jmod->errorLine())
+                    .arg(m_jmod->errorOffset());
+        }
+        QMessageBox::warning(this, "Open", text);
+    }
+}
+
+void VariantTreeWidget::saveProgress(qint64 bytesWritten)
+{
+    m_status->setText(QString("Saving... %1 MiB").arg(bytesWritten >> 20));
+}
+
+void VariantTreeWidget::saveFinished(bool success, qint64 bytesWritten, qint64 elapsedMs)
+{
+    if (!success) {
+        m_status->clear();
+        QMessageBox::warning(this, "Save as", m_jmod->errorString());
+        return;
+    }
+
+    m_status->setText(QString("Saved %1 KiB in %2 ms")
+                      .arg(bytesWritten >> 10)
+                      .arg(elapsedMs));
+}
+
+void VariantTreeWidget::undoStackChanged()
+{
+    m_btnUndo->setEnabled(m_jmod->canUndo());
+    m_btnRedo->setEnabled(m_jmod->canRedo());
+}
+
+void VariantTreeWidget::find()
+{
+    int mode = m_findMode->currentData().toInt();
+    QModelIndexList indexes;
+
+    if (mode == QueryMode && m_findText->text().startsWith('/') && !m_findText->text().contains('*')) {
+        // plain pointers are "go to path"
+        QModelIndex idx = m_jmod->indexForPointer(m_findText->text());
+        if (idx.isValid())
+            indexes.append(idx);
+        m_status->setText(idx.isValid() ? QString() : QString("%1: not found").arg(m_findText->text()));
+    } else if (mode == QueryMode) {
+        JsonQuery query;
+        if (!query.compile(m_findText->text())) {
+            m_status->setText(QString("%1 at %2")
+                              .arg(query.errorString())
+                              .arg(query.errorOffset()));
+            return;
+        }
+        indexes = m_jmod->indexesForQuery(query);
+        m_status->setText(QString("%1 matches").arg(indexes.count()));
+    } else {
+        QList<QVector<int>> hits = m_search->search(m_findText->text(), SearchIndex::MatchMode(mode));
+        for (const QVector<int>& path : hits)
+            indexes.append(m_jmod->indexForPath(path));
+        m_status->setText(QString("%1 matches%2")
+                          .arg(hits.count())
+                          .arg(m_search->isReady() ? "" : " (indexing)"));
+    }
+
+    QItemSelection selection;
+    int lastColumn = m_jmod->columnCount() - 1;
+    for (const QModelIndex& idx : indexes) {
+        if (idx.isValid())
+            selection.select(idx, idx.sibling(idx.row(), lastColumn));
+    }
+
+    m_jview->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect);
+
+    if (!selection.isEmpty()) {
+        QModelIndex first = selection.first().topLeft();
+        m_jview->selectionModel()->setCurrentIndex(first, QItemSelectionModel::NoUpdate);
+        m_jview->scrollTo(first);
+    }
+}
+
+void VariantTreeWidget::copy()
+{
+    // a snapshot of shared values, JSON is written when another application pastes
+    QMimeData* data = m_jmod->copyIndexes(m_jview->selectionModel()->selectedIndexes());
+    if (data)
+        QApplication::clipboard()->setMimeData(data);
+}
+
+void VariantTreeWidget::cut()
+{
+    QModelIndexList indexes = m_jview->selectionModel()->selectedIndexes();
+    QMimeData* data = m_jmod->copyIndexes(indexes);
+    if (!data)
+        return;
+
+    QApplication::clipboard()->setMimeData(data);
+    m_jmod->removeIndexes(indexes);
+}
+
+void VariantTreeWidget::paste()
+{
+    // into the current container, or next to the current value
+    QModelIndex idx = m_jview->currentIndex();
+    if (!m_jmod->paste(QApplication::clipboard()->mimeData(), idx))
+        m_status->setText("Nothing to paste");
+}
+
 void VariantTreeWidget::btnOpen_clicked()
 {
     QFileDialog dialog(this);
@@ -109,7 +335,10 @@ void VariantTreeWidget::btnOpen_clicked()
         fileNames = dialog.selectedFiles();
 
     if (fileNames.size() > 0) {
-        m_jmod->load(fileNames.first());
+        if (m_jmod->loadAsync(fileNames.first())) {
+            m_progress->setLabelText("Loading...");
+            m_progress->setValue(0);
+        }
     }
 }
 
@@ -118,18 +347,26 @@ void VariantTreeWidget::btnSaveAs_clicked()
     QString fn = QFileDialog::getSaveFileName(this, "Save As");
 
     if (fn.size() > 0) {
-        QJsonDocument jdoc = QJsonDocument::fromVariant(m_jmod->variantTree());
-
-        QFile f(fn);
-        f.open( QIODevice::WriteOnly );
-        f.write(jdoc.toJson());
-        f.close();
+        if (m_jmod->saveAsync(fn))
+            m_status->setText("Saving...");
+        else
+            QMessageBox::warning(this, "Save as", "Previous save is still in progress");
     }
 }
 
 void VariantTreeWidget::btnClose_clicked()
 {
     m_jmod->destroy();
+    updateDelegate();
+}
+
+void VariantTreeWidget::updateDelegate()
+{
+    // binary formats keep the same integer and float types as YAML
+    if (m_jmod->documentFormat() != VariantTreeModel::Json)
+        m_jview->setItemDelegate(m_yamlDelegate);
+    else
+        m_jview->setItemDelegate(m_jsonDelegate);
 }
 
 void VariantTreeWidget::btnAdd_clicked()
@@ -148,7 +385,7 @@ void VariantTreeWidget::btnAdd_clicked()
         item = m_jmod->rootItem();
 
     if (item->isArray()) {
-        int row = item->childCount();
+        int row = item->valueCount();
         m_jmod->insertRow(row, idx);
     } else if (item->isObject())
         m_jmod->insertRow(0, idx);
@@ -169,7 +406,7 @@ void VariantTreeWidget::btnInsert_clicked()
     if (row > 0)
         m_jmod->insertRow(row, idx);
     else if (item->isArray()) {
-        row = item->childCount();
+        row = item->valueCount();
         m_jmod->insertRow(row, idx);
     } else
         m_jmod->insertRow(0, idx);
@@ -177,14 +414,16 @@ void VariantTreeWidget::btnInsert_clicked()
 
 void VariantTreeWidget::btnDelete_clicked()
 {
-    QModelIndex idx = m_jview->currentIndex();
+    QModelIndexList indexes = m_jview->selectionModel()->selectedIndexes();
 
-    if (!idx.isValid())
-        return;
+    if (indexes.isEmpty()) {
+        QModelIndex idx = m_jview->currentIndex();
+        if (!idx.isValid())
+            return;
+        indexes.append(idx);
+    }
 
-    int row = idx.row();
-    QModelIndex parent = idx.parent();
-    m_jmod->removeRow(row, parent);
+    m_jmod->removeIndexes(indexes);
 }
 
 void VariantTreeWidget::btnChange_clicked()
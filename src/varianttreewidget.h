@@ -1,10 +1,16 @@
 #ifndef VARIANTTREEWIDGET_H
 #define VARIANTTREEWIDGET_H
 
+#include <QComboBox>
+#include <QLabel>
+#include <QLineEdit>
+#include <QProgressDialog>
+#include <QPushButton>
 #include <QTreeView>
 #include <QWidget>
 
 #include "jsondelegate.h"
+#include "searchindex.h"
 #include "varianttreemodel.h"
 #include "yamldelegate.h"
 
@@ -19,6 +25,20 @@ signals:
 public slots:
     void rowMoved();
 
+    void loadProgress(qint64 bytesProcessed, qint64 bytesTotal, qint64 nodeCount);
+    void loadFinished(bool success);
+
+    void saveProgress(qint64 bytesWritten);
+    void saveFinished(bool success, qint64 bytesWritten, qint64 elapsedMs);
+
+    void undoStackChanged();
+
+    void find();
+
+    void copy();
+    void cut();
+    void paste();
+
     void btnOpen_clicked();
     void btnSaveAs_clicked();
     void btnClose_clicked();
@@ -32,8 +52,21 @@ public slots:
     void btnUp_clicked();
 
 private:
+    void updateDelegate();
+
     VariantTreeModel* m_jmod;
     QTreeView* m_jview;
+    JsonDelegate* m_jsonDelegate;
+    YamlDelegate* m_yamlDelegate;
+    QProgressDialog* m_progress;
+    QLabel* m_status;
+
+    SearchIndex* m_search;
+    QLineEdit* m_findText;
+    QComboBox* m_findMode;
+
+    QPushButton* m_btnUndo;
+    QPushButton* m_btnRedo;
 
     QAction* m_action;
     QMenu* m_menu;
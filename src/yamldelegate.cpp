@@ -9,6 +9,7 @@ YamlDelegate::YamlDelegate(QObject* parent)
 {
     m_lst << "[array]"
           << "[bool]"
+          << "[bytearray]"
           << "[double]"
           << "[float]"
           << "[int]"
@@ -61,38 +62,41 @@ void YamlDelegate::setEditorData(QWidget* editor, const QModelIndex& index) cons
         case QVariant::Bool:
             cmbIndex = 1;
             break;
-        case QVariant::Double:
+        case QVariant::ByteArray:
             cmbIndex = 2;
             break;
-        case QMetaType::Float:
+        case QVariant::Double:
             cmbIndex = 3;
             break;
-        case QVariant::Int:
+        case QMetaType::Float:
             cmbIndex = 4;
             break;
+        case QVariant::Int:
+            cmbIndex = 5;
+            break;
         case QVariant::Invalid:
-            cmbIndex = 10;
+            cmbIndex = 11;
             break;
         case QVariant::LongLong:
-            cmbIndex = 5;
+            cmbIndex = 6;
             break;
         case QVariant::List:
             cmbIndex = 0;
             break;
         case QVariant::Map:
-            cmbIndex = 6;
+            cmbIndex = 7;
             break;
         case QVariant::String:
-            cmbIndex = 7;
+            cmbIndex = 8;
             break;
         case QVariant::UInt:
-            cmbIndex = 8;
+            cmbIndex = 9;
             break;
         case QVariant::ULongLong:
-            cmbIndex = 9;
+            cmbIndex = 10;
             break;
         default:
-            cmbIndex = 10;
+            cmbIndex = 11;
             break;
         }
 
@@ -120,6 +124,15 @@ void YamlDelegate::setModelData(QWidget* editor, QAbstractItemModel* model, cons
 
         uint itemType = item->valueType();
         switch (itemType) {
+        case QVariant::ByteArray: {
+            // edited as base64 text, see VariantTreeModel::data()
+            lineEdit = qobject_cast<QLineEdit*>(editor);
+            if (lineEdit) {
+                model->setData(index, QByteArray::fromBase64(lineEdit->text().toLatin1()));
+                return;
+            }
+            break;
+        }
         case QMetaType::Float: {
             lineEdit = qobject_cast<QLineEdit*>(editor);
             if (lineEdit) {
@@ -172,30 +185,33 @@ void YamlDelegate::setModelData(QWidget* editor, QAbstractItemModel* model, cons
             itemType = QVariant::Bool;
             break;
         case 2:
-            itemType = QVariant::Double;
+            itemType = QVariant::ByteArray;
             break;
         case 3:
-            itemType = QMetaType::Float;
+            itemType = QVariant::Double;
             break;
         case 4:
-            itemType = QVariant::Int;
+            itemType = QMetaType::Float;
             break;
         case 5:
-            itemType = QVariant::LongLong;
+            itemType = QVariant::Int;
             break;
         case 6:
-            itemType = QVariant::Map;
+            itemType = QVariant::LongLong;
             break;
         case 7:
-            itemType = QVariant::String;
+            itemType = QVariant::Map;
             break;
         case 8:
-            itemType = QVariant::UInt;
+            itemType = QVariant::String;
             break;
         case 9:
-            itemType = QVariant::ULongLong;
+            itemType = QVariant::UInt;
             break;
         case 10:
+            itemType = QVariant::ULongLong;
+            break;
+        case 11:
             itemType = QVariant::Invalid;
             break;
         default:
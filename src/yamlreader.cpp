@@ -0,0 +1,481 @@
+#include <cctype>
+#include <climits>
+#include <istream>
+#include <streambuf>
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QHash>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent>
+#include <QtNumeric>
+
+#include <yaml-cpp/eventhandler.h>
+#include <yaml-cpp/exceptions.h>
+#include <yaml-cpp/parser.h>
+
+#include "yamlreader.h"
+
+namespace {
+
+const char* const StrTag = "tag:yaml.org,2002:str";
+const char* const IntTag = "tag:yaml.org,2002:int";
+const char* const FloatTag = "tag:yaml.org,2002:float";
+const char* const BoolTag = "tag:yaml.org,2002:bool";
+const char* const NullTag = "tag:yaml.org,2002:null";
+const char* const BinaryTag = "tag:yaml.org,2002:binary";
+
+// read-only view of the mapped document, nothing is copied
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+    MemoryStreamBuf(const char* begin, const char* end)
+    {
+        char* p = const_cast<char*>(begin);
+        setg(p, p, const_cast<char*>(end));
+    }
+
+    qint64 position() const
+    { return gptr() - eback(); }
+};
+
+// builds the documents straight from the parser events
+class VariantBuilder : public YAML::EventHandler
+{
+public:
+    explicit VariantBuilder(QVariantList* documents) :
+        m_documents(documents),
+        m_nodeCount(0)
+    {}
+
+    qint64 nodeCount() const
+    { return m_nodeCount; }
+
+    void OnDocumentStart(const YAML::Mark&)
+    {
+        m_stack.clear();
+        m_root = QVariant();
+    }
+
+    void OnDocumentEnd()
+    {
+        m_documents->append(QVariant());
+        m_documents->last().swap(m_root);
+    }
+
+    void OnNull(const YAML::Mark&, YAML::anchor_t anchor)
+    {
+        addValue(QVariant(), anchor);
+    }
+
+    void OnAlias(const YAML::Mark&, YAML::anchor_t anchor)
+    {
+        // anchored values are shared, not copied
+        addValue(m_anchors.value(anchor), 0);
+    }
+
+    void OnScalar(const YAML::Mark&, const std::string& tag, YAML::anchor_t anchor, const std::string& value)
+    {
+        // keys are kept as written
+        if (!m_stack.isEmpty() && m_stack.last().expectKey) {
+            Frame& frame = m_stack.last();
+            frame.key = QString::fromStdString(value);
+            frame.expectKey = false;
+            return;
+        }
+
+        addValue(YamlReader::scalarValue(tag, value), anchor);
+    }
+
+    void OnSequenceStart(const YAML::Mark& mark, const std::string&, YAML::anchor_t anchor, YAML::EmitterStyle::value)
+    {
+        startContainer(mark, QVariantList(), anchor);
+    }
+
+    void OnSequenceEnd()
+    {
+        endContainer();
+    }
+
+    void OnMapStart(const YAML::Mark& mark, const std::string&, YAML::anchor_t anchor, YAML::EmitterStyle::value)
+    {
+        startContainer(mark, QVariantMap(), anchor);
+    }
+
+    void OnMapEnd()
+    {
+        endContainer();
+    }
+
+private:
+    struct Frame
+    {
+        QVariant value;
+        QString key;
+        YAML::anchor_t anchor;
+        bool expectKey;
+    };
+
+    void startContainer(const YAML::Mark& mark, const QVariant& value, YAML::anchor_t anchor)
+    {
+        if (!m_stack.isEmpty() && m_stack.last().expectKey)
+            throw YAML::ParserException(mark, "complex keys are not supported");
+
+        Frame frame;
+        frame.value = value;
+        frame.anchor = anchor;
+        frame.expectKey = value.type() == QVariant::Map;
+        m_stack.append(frame);
+    }
+
+    void endContainer()
+    {
+        QVariant value;
+        value.swap(m_stack.last().value);
+        YAML::anchor_t anchor = m_stack.last().anchor;
+
+        m_stack.removeLast();
+        addValue(value, anchor);
+    }
+
+    void addValue(QVariant& value, YAML::anchor_t anchor)
+    {
+        m_nodeCount++;
+        if (anchor)
+            m_anchors.insert(anchor, value);
+
+        if (m_stack.isEmpty()) {
+            m_root.swap(value);
+            return;
+        }
+
+        Frame& frame = m_stack.last();
+        if (frame.value.type() == QVariant::List) {
+            QVariantList& arr = *reinterpret_cast<QVariantList*>(frame.value.data());
+            arr.append(QVariant());
+            arr.last().swap(value);
+        } else if (frame.expectKey) {
+            // null and alias keys
+            frame.key = value.toString();
+            frame.expectKey = false;
+        } else {
+            QVariantMap& obj = *reinterpret_cast<QVariantMap*>(frame.value.data());
+            obj[frame.key].swap(value);
+            frame.expectKey = true;
+        }
+    }
+
+    void addValue(const QVariant& value, YAML::anchor_t anchor)
+    {
+        QVariant copy = value;
+        addValue(copy, anchor);
+    }
+
+    QVariantList* m_documents;
+    QVector<Frame> m_stack;
+    QVariant m_root;
+    QHash<YAML::anchor_t, QVariant> m_anchors;
+    qint64 m_nodeCount;
+};
+
+bool isDigits(const char* p, const char* end, int base)
+{
+    if (p == end)
+        return false;
+
+    for (; p < end; p++) {
+        char c = *p;
+        bool ok = base == 16 ? std::isxdigit(uchar(c)) : (c >= '0' && c < '0' + base);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+QVariant integerValue(const std::string& str, bool* ok)
+{
+    const char* p = str.data();
+    const char* end = p + str.size();
+
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+
+    int base = 10;
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'o')) {
+        base = p[1] == 'x' ? 16 : 8;
+        p += 2;
+    }
+
+    *ok = isDigits(p, end, base);
+    if (!*ok)
+        return QVariant();
+
+    QByteArray digits = QByteArray::fromRawData(p, int(end - p));
+    qulonglong magnitude = digits.toULongLong(ok, base);
+    if (!*ok)
+        return QVariant();
+
+    if (negative) {
+        if (magnitude > qulonglong(LLONG_MAX) + 1) {
+            *ok = false;
+            return QVariant();
+        }
+        qlonglong value = qlonglong(0 - magnitude);
+        if (value >= INT_MIN)
+            return int(value);
+        return value;
+    }
+
+    if (magnitude <= qulonglong(INT_MAX))
+        return int(magnitude);
+    if (magnitude <= qulonglong(LLONG_MAX))
+        return qlonglong(magnitude);
+    return magnitude;
+}
+
+QVariant floatValue(const std::string& str, bool* ok)
+{
+    *ok = true;
+    if (str == ".inf" || str == ".Inf" || str == ".INF" || str == "+.inf" || str == "+.Inf" || str == "+.INF")
+        return qInf();
+    if (str == "-.inf" || str == "-.Inf" || str == "-.INF")
+        return -qInf();
+    if (str == ".nan" || str == ".NaN" || str == ".NAN")
+        return qQNaN();
+
+    // toDouble() alone would accept "inf" and "nan" as well
+    *ok = str.find_first_of("0123456789") != std::string::npos
+            && str.find_first_not_of("0123456789.-+eE") == std::string::npos;
+    if (!*ok)
+        return QVariant();
+
+    double value = QByteArray::fromRawData(str.data(), int(str.size())).toDouble(ok);
+    return *ok ? QVariant(value) : QVariant();
+}
+
+} // namespace
+
+YamlReader::YamlReader(const char* data, qint64 size) :
+    m_begin(data),
+    m_end(data + size),
+    m_nodeCount(0),
+    m_documentCount(0),
+    m_errorOffset(-1)
+{
+}
+
+bool YamlReader::read(QVariant& value)
+{
+    QVariantList documents;
+    if (!readDocuments(documents))
+        return false;
+
+    setDocuments(documents, value);
+    return true;
+}
+
+bool YamlReader::readParallel(QVariant& value)
+{
+    m_nodeCount = 0;
+    m_errorString.clear();
+    m_errorOffset = -1;
+
+    // "---" at the start of a line always starts a document, scalars
+    // cannot contain such a line; directives would belong to the next
+    // chunk, so streams with them are read sequentially
+    struct Chunk
+    {
+        const char* begin;
+        const char* end;
+
+        QVariantList documents;
+        qint64 nodeCount;
+        bool failed;
+    };
+
+    const qint64 chunkSize = qMax<qint64>((m_end - m_begin) / (QThread::idealThreadCount() * 8), 1 << 16);
+
+    QVector<Chunk> chunks;
+    const char* chunkBegin = m_begin;
+    bool directives = false;
+
+    for (const char* p = m_begin; p < m_end && !directives; p++) {
+        if (p != m_begin && p[-1] != '\n')
+            continue;
+
+        if (*p == '%') {
+            directives = true;
+        } else if (m_end - p >= 3 && p[0] == '-' && p[1] == '-' && p[2] == '-'
+                   && (m_end - p == 3 || std::isspace(uchar(p[3])))) {
+            if (p - chunkBegin >= chunkSize) {
+                chunks.append({ chunkBegin, p, QVariantList(), 0, false });
+                chunkBegin = p;
+            }
+        }
+    }
+
+    if (directives || chunks.isEmpty())
+        return read(value);
+
+    chunks.append({ chunkBegin, m_end, QVariantList(), 0, false });
+
+    QAtomicInteger<qint64> bytesDone(0);
+    QAtomicInteger<qint64> nodesDone(0);
+    QAtomicInt cancelled(0);
+
+    auto parseChunk = [&](Chunk& chunk) {
+        YamlReader reader(chunk.begin, chunk.end - chunk.begin);
+
+        if (m_progressFunc) {
+            qint64 lastBytes = 0;
+            qint64 lastNodes = 0;
+
+            reader.setProgressFunc([&, lastBytes, lastNodes](qint64 bytesProcessed, qint64 nodeCount) mutable {
+                qint64 bytes = bytesDone.fetchAndAddOrdered(bytesProcessed - lastBytes) + bytesProcessed - lastBytes;
+                qint64 nodes = nodesDone.fetchAndAddOrdered(nodeCount - lastNodes) + nodeCount - lastNodes;
+                lastBytes = bytesProcessed;
+                lastNodes = nodeCount;
+
+                if (cancelled.load() || !m_progressFunc(bytes, nodes)) {
+                    cancelled.store(1);
+                    return false;
+                }
+                return true;
+            });
+        }
+
+        chunk.failed = !reader.readDocuments(chunk.documents);
+        chunk.nodeCount = reader.m_nodeCount;
+    };
+
+    QtConcurrent::blockingMap(chunks, parseChunk);
+
+    if (cancelled.load()) {
+        m_errorString = QStringLiteral("loading cancelled");
+        m_errorOffset = 0;
+        return false;
+    }
+
+    QVariantList documents;
+    for (Chunk& chunk : chunks) {
+        // the sequential parser reports the exact error
+        if (chunk.failed)
+            return read(value);
+
+        m_nodeCount += chunk.nodeCount;
+        documents.append(chunk.documents);
+    }
+
+    setDocuments(documents, value);
+    return true;
+}
+
+bool YamlReader::readDocuments(QVariantList& documents)
+{
+    m_nodeCount = 0;
+    m_errorString.clear();
+    m_errorOffset = -1;
+
+    MemoryStreamBuf buffer(m_begin, m_end);
+    std::istream stream(&buffer);
+    VariantBuilder builder(&documents);
+
+    try {
+        YAML::Parser parser(stream);
+        while (parser.HandleNextDocument(builder)) {
+            m_nodeCount = builder.nodeCount();
+            if (m_progressFunc && !m_progressFunc(buffer.position(), m_nodeCount)) {
+                m_errorString = QStringLiteral("loading cancelled");
+                m_errorOffset = buffer.position();
+                return false;
+            }
+        }
+    } catch (const YAML::Exception& e) {
+        m_errorString = QString::fromStdString(e.msg);
+        m_errorOffset = e.mark.is_null() ? buffer.position() : e.mark.pos;
+        return false;
+    }
+
+    m_nodeCount = builder.nodeCount();
+    return true;
+}
+
+void YamlReader::setDocuments(QVariantList& documents, QVariant& value)
+{
+    m_documentCount = documents.count();
+
+    if (documents.count() == 1)
+        value.swap(documents.first());
+    else if (documents.isEmpty())
+        value = QVariant();
+    else
+        value = documents;
+}
+
+int YamlReader::errorLine() const
+{
+    if (m_errorOffset < 0)
+        return 0;
+
+    int line = 1;
+    const char* end = m_begin + m_errorOffset;
+    for (const char* p = m_begin; p < end; p++) {
+        if (*p == '\n')
+            line++;
+    }
+    return line;
+}
+
+QVariant YamlReader::scalarValue(const std::string& tag, const std::string& value)
+{
+    bool ok;
+
+    // quoted and block scalars have the non-specific tag "!"
+    if (tag == "!" || tag == StrTag)
+        return QString::fromStdString(value);
+
+    if (tag == NullTag)
+        return QVariant();
+
+    if (tag == BoolTag)
+        return value == "true" || value == "True" || value == "TRUE";
+
+    // base64 text, line breaks are skipped
+    if (tag == BinaryTag)
+        return QByteArray::fromBase64(QByteArray::fromStdString(value));
+
+    if (tag == IntTag) {
+        QVariant number = integerValue(value, &ok);
+        return ok ? number : QVariant(QString::fromStdString(value));
+    }
+
+    if (tag == FloatTag) {
+        QVariant number = floatValue(value, &ok);
+        if (!ok)
+            number = integerValue(value, &ok);
+        return ok ? QVariant(number.toDouble()) : QVariant(QString::fromStdString(value));
+    }
+
+    // application tags keep the text
+    if (tag != "?" && !tag.empty())
+        return QString::fromStdString(value);
+
+    if (value.empty() || value == "~" || value == "null" || value == "Null" || value == "NULL")
+        return QVariant();
+    if (value == "true" || value == "True" || value == "TRUE")
+        return true;
+    if (value == "false" || value == "False" || value == "FALSE")
+        return false;
+
+    QVariant number = integerValue(value, &ok);
+    if (ok)
+        return number;
+
+    number = floatValue(value, &ok);
+    if (ok)
+        return number;
+
+    return QString::fromStdString(value);
+}
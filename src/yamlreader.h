@@ -0,0 +1,65 @@
+#ifndef YAMLREADER_H
+#define YAMLREADER_H
+
+#include <functional>
+#include <string>
+
+#include <QString>
+#include <QVariant>
+
+class YamlReader
+{
+    using This = YamlReader;
+
+public:
+    // called with the bytes parsed so far and the node count,
+    // returning false cancels the parsing
+    using ProgressFunc = std::function<bool(qint64, qint64)>;
+
+    YamlReader(const char* data, qint64 size);
+
+    void setProgressFunc(ProgressFunc func)
+    { m_progressFunc = func; }
+
+    // builds QVariantList/QVariantMap nodes from the parser events,
+    // a stream of several documents is read as an array of them
+    bool read(QVariant& value);
+
+    // same as read(), but the stream is split at "---" lines and
+    // the documents are parsed on the global thread pool
+    bool readParallel(QVariant& value);
+
+    int documentCount() const
+    { return m_documentCount; }
+
+    // error getters
+    const QString& errorString() const
+    { return m_errorString; }
+    qint64 errorOffset() const
+    { return m_errorOffset; }
+    int errorLine() const;
+
+    qint64 nodeCount() const
+    { return m_nodeCount; }
+
+    // core schema resolution of a scalar, keeping int, longlong,
+    // ulonglong and double apart; "?" is the tag of plain scalars
+    static QVariant scalarValue(const std::string& tag, const std::string& value);
+
+private:
+    bool readDocuments(QVariantList& documents);
+    void setDocuments(QVariantList& documents, QVariant& value);
+
+    const char* m_begin;
+    const char* m_end;
+
+    qint64 m_nodeCount;
+    int m_documentCount;
+
+    ProgressFunc m_progressFunc;
+
+    QString m_errorString;
+    qint64 m_errorOffset;
+};
+
+#endif // YAMLREADER_H
@@ -0,0 +1,218 @@
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QLocale>
+#include <QtNumeric>
+
+#include <yaml-cpp/binary.h>
+#include <yaml-cpp/emitter.h>
+#include <yaml-cpp/emittermanip.h>
+
+#include "yamlreader.h"
+#include "yamlwriter.h"
+
+namespace {
+
+const int BufferSize = 1 << 16;
+
+// buffered output to the device, the emitter writes as it goes
+class DeviceStreamBuf : public std::streambuf
+{
+public:
+    DeviceStreamBuf(QIODevice* device, const YamlWriter::ProgressFunc& progress) :
+        m_device(device),
+        m_buffer(BufferSize),
+        m_bytesWritten(0),
+        m_progressFunc(progress)
+    {
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+    }
+
+    qint64 bytesWritten() const
+    { return m_bytesWritten; }
+
+protected:
+    int_type overflow(int_type ch)
+    {
+        if (!flush())
+            return traits_type::eof();
+
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync()
+    {
+        return flush() ? 0 : -1;
+    }
+
+private:
+    bool flush()
+    {
+        qint64 size = pptr() - pbase();
+        if (size == 0)
+            return true;
+
+        qint64 written = m_device->write(pbase(), size);
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+
+        if (written != size)
+            return false;
+
+        m_bytesWritten += written;
+        if (m_progressFunc)
+            m_progressFunc(m_bytesWritten);
+
+        return true;
+    }
+
+    QIODevice* m_device;
+    std::vector<char> m_buffer;
+    qint64 m_bytesWritten;
+    const YamlWriter::ProgressFunc& m_progressFunc;
+};
+
+void emitString(YAML::Emitter& out, const QString& str)
+{
+    std::string utf8 = str.toStdString();
+
+    // plain "123" or "true" would be read back as another type
+    if (YamlReader::scalarValue("?", utf8).type() != QVariant::String)
+        out << YAML::DoubleQuoted;
+    out << utf8;
+}
+
+// the emitter's own stream output writes 1.0 as "1", which reads back as an int
+void emitFloat(YAML::Emitter& out, double d, bool single)
+{
+    if (qIsNaN(d)) {
+        out << ".nan";
+        return;
+    }
+    if (qIsInf(d)) {
+        out << (d < 0 ? "-.inf" : ".inf");
+        return;
+    }
+
+    QByteArray text;
+    if (single) {
+        // shortest digits that give the float back
+        for (int precision = 6; precision <= 9; precision++) {
+            text = QByteArray::number(d, 'g', precision);
+            if (text.toFloat() == float(d))
+                break;
+        }
+    } else {
+        text = QByteArray::number(d, 'g', QLocale::FloatingPointShortest);
+    }
+
+    if (text.indexOf('.') < 0 && text.indexOf('e') < 0 && text.indexOf('n') < 0)
+        text.append(".0");
+
+    out << text.toStdString();
+}
+
+void emitValue(YAML::Emitter& out, const QVariant& value)
+{
+    uint type = value.type();
+
+    switch (type) {
+    case QVariant::Invalid:
+        out << YAML::Null;
+        break;
+    case QVariant::Bool:
+        out << value.toBool();
+        break;
+    case QVariant::Int:
+    case QVariant::LongLong:
+        out << static_cast<long long>(value.toLongLong());
+        break;
+    case QVariant::UInt:
+    case QVariant::ULongLong:
+        out << static_cast<unsigned long long>(value.toULongLong());
+        break;
+    case QVariant::Double:
+        emitFloat(out, value.toDouble(), false);
+        break;
+    case QMetaType::Float:
+        emitFloat(out, value.toFloat(), true);
+        break;
+    case QVariant::List: {
+        const QVariantList& arr = *reinterpret_cast<const QVariantList*>(value.constData());
+        out << YAML::BeginSeq;
+        for (const QVariant& item : arr)
+            emitValue(out, item);
+        out << YAML::EndSeq;
+        break;
+    }
+    case QVariant::Map: {
+        const QVariantMap& obj = *reinterpret_cast<const QVariantMap*>(value.constData());
+        out << YAML::BeginMap;
+        for (auto it = obj.constBegin(); it != obj.constEnd(); it++) {
+            out << YAML::Key;
+            emitString(out, it.key());
+            out << YAML::Value;
+            emitValue(out, it.value());
+        }
+        out << YAML::EndMap;
+        break;
+    }
+    case QVariant::String:
+        emitString(out, *reinterpret_cast<const QString*>(value.constData()));
+        break;
+    case QVariant::ByteArray: {
+        const QByteArray& bytes = *reinterpret_cast<const QByteArray*>(value.constData());
+        out << YAML::Binary(reinterpret_cast<const unsigned char*>(bytes.constData()), bytes.size());
+        break;
+    }
+    default:
+        // dates, urls and uuids as their text
+        emitString(out, value.toString());
+        break;
+    }
+}
+
+} // namespace
+
+YamlWriter::YamlWriter(QIODevice* device) :
+    m_device(device),
+    m_bytesWritten(0)
+{
+}
+
+bool YamlWriter::write(const QVariant& value, bool multiDocument)
+{
+    m_errorString.clear();
+
+    DeviceStreamBuf buffer(m_device, m_progressFunc);
+    std::ostream stream(&buffer);
+
+    YAML::Emitter out(stream);
+    out.SetOutputCharset(YAML::EmitNonAscii);
+
+    if (multiDocument && value.type() == QVariant::List) {
+        for (const QVariant& document : *reinterpret_cast<const QVariantList*>(value.constData())) {
+            out << YAML::BeginDoc;
+            emitValue(out, document);
+        }
+    } else {
+        emitValue(out, value);
+    }
+
+    stream << '\n';
+    stream.flush();
+
+    if (!out.good())
+        m_errorString = QString::fromStdString(out.GetLastError());
+    else if (!stream.good())
+        m_errorString = m_device->errorString();
+
+    m_bytesWritten = buffer.bytesWritten();
+    return m_errorString.isEmpty();
+}
@@ -0,0 +1,42 @@
+#ifndef YAMLWRITER_H
+#define YAMLWRITER_H
+
+#include <functional>
+
+#include <QString>
+#include <QVariant>
+
+class QIODevice;
+
+class YamlWriter
+{
+    using This = YamlWriter;
+
+public:
+    using ProgressFunc = std::function<void(qint64)>;
+
+    explicit YamlWriter(QIODevice* device);
+
+    // called with the total byte count after each buffer flush
+    void setProgressFunc(const ProgressFunc& func)
+    { m_progressFunc = func; }
+
+    // streams the value through the emitter, with multiDocument
+    // the elements of an array are written as separate documents
+    bool write(const QVariant& value, bool multiDocument = false);
+
+    qint64 bytesWritten() const
+    { return m_bytesWritten; }
+    const QString& errorString() const
+    { return m_errorString; }
+
+private:
+    QIODevice* m_device;
+    qint64 m_bytesWritten;
+
+    ProgressFunc m_progressFunc;
+
+    QString m_errorString;
+};
+
+#endif // YAMLWRITER_H
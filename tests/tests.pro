@@ -0,0 +1,13 @@
+TARGET = tst_varianttree
+TEMPLATE = app
+
+QT += core testlib
+QT -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+include(../src/varianttree.pri)
+
+SOURCES += \
+    tst_varianttree.cpp
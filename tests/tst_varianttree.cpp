@@ -0,0 +1,415 @@
+#include <climits>
+
+#include <QBuffer>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtTest>
+
+#include "searchindex.h"
+#include "varianttreemodel.h"
+
+namespace {
+
+// {"list": [1, 2, 3], "object": {"x": true, "y": "text"}, "other": []}
+QVariantMap undoDocument()
+{
+    QVariantMap object;
+    object.insert("x", true);
+    object.insert("y", QString("text"));
+
+    QVariantMap root;
+    root.insert("list", QVariantList() << 1 << 2 << 3);
+    root.insert("object", object);
+    root.insert("other", QVariantList());
+    return root;
+}
+
+// saves the model into a buffer and loads that into loaded
+bool roundTrip(VariantTreeModel& model, VariantTreeModel::DocumentFormat format, VariantTreeModel& loaded)
+{
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    if (!model.save(&buffer, format))
+        return false;
+    buffer.close();
+
+    buffer.open(QIODevice::ReadOnly);
+    return loaded.load(&buffer, format);
+}
+
+// the edit is done already, the tree goes back and forth once
+void compareUndoRedo(VariantTreeModel& model, const QVariant& before, const QVariant& after)
+{
+    QCOMPARE(model.variantTree(), after);
+
+    QVERIFY(model.canUndo());
+    model.undo();
+    QCOMPARE(model.variantTree(), before);
+
+    QVERIFY(model.canRedo());
+    model.redo();
+    QCOMPARE(model.variantTree(), after);
+}
+
+} // namespace
+
+class TestVariantTree : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void searchEditsDuringFullBuild();
+    void searchLargeDocument();
+    void yamlNumberRoundTrip();
+    void binaryRoundTrip_data();
+    void binaryRoundTrip();
+    void binaryMultiDocument_data();
+    void binaryMultiDocument();
+    void binaryMalformed_data();
+    void binaryMalformed();
+
+    void undoRemove();
+    void undoMoveAcrossParents();
+    void undoTypeConversion();
+    void undoKeyRename();
+};
+
+void TestVariantTree::searchEditsDuringFullBuild()
+{
+    // {"data": [{"name": "item0", "value": 0}, ...]}
+    QByteArray json = "{\"data\": [";
+    for (int i = 0; i < 100; i++) {
+        if (i > 0)
+            json += ',';
+        json += QString("{\"name\": \"item%1\", \"value\": %1}").arg(i).toUtf8();
+    }
+    json += "]}";
+
+    VariantTreeModel model;
+    QVERIFY(model.loadJson(json));
+
+    // the full build queues behind a blocked pool and stays running
+    QThreadPool* pool = QThreadPool::globalInstance();
+    int maxThreadCount = pool->maxThreadCount();
+    pool->setMaxThreadCount(1);
+    QSemaphore gate;
+    QFuture<void> blocker = QtConcurrent::run([&gate]() {
+        gate.acquire();
+    });
+
+    SearchIndex index(&model);
+    QTest::qWait(500);
+    QVERIFY(!index.isReady());
+
+    // a changed value, an insert and a removal inside data
+    QModelIndex name = model.indexForPointer("/data/5/name");
+    QVERIFY(model.setData(name.sibling(name.row(), VariantTreeModel::ValueColumn), QString("needle")));
+    QModelIndex data = model.indexForPointer("/data");
+    QVERIFY(model.insertRows(3, 2, data));
+    QVERIFY(model.removeRows(0, 1, data));
+
+    // the tree is searched directly until the build is done
+    QCOMPARE(index.search("needle").count(), 1);
+
+    gate.release();
+    blocker.waitForFinished();
+    pool->setMaxThreadCount(maxThreadCount);
+
+    QTRY_VERIFY_WITH_TIMEOUT(index.isReady(), 10000);
+
+    // two rows inserted before and one removed
+    QList<QVector<int>> hits = index.search("needle");
+    QCOMPARE(hits.count(), 1);
+    QCOMPARE(hits.first(), QVector<int>() << 0 << 6 << 0);
+
+    hits = index.search("item42");
+    QCOMPARE(hits.count(), 1);
+    QCOMPARE(hits.first(), QVector<int>() << 0 << 43 << 0);
+
+    QVERIFY(index.search("item0").isEmpty());
+}
+
+void TestVariantTree::searchLargeDocument()
+{
+    // {"data": ["value0", ...], "meta": {"a": "b"}}, data is split into buckets below it
+    QVariantList data;
+    for (int i = 0; i < 20000; i++)
+        data.append(QString("value%1").arg(i));
+    QVariantMap meta;
+    meta.insert("a", "b");
+    QVariantMap root;
+    root.insert("data", data);
+    root.insert("meta", meta);
+
+    VariantTreeModel model;
+    model.loadVariantTree(root);
+
+    SearchIndex index(&model);
+    QTRY_VERIFY_WITH_TIMEOUT(index.isReady(), 10000);
+
+    QList<QVector<int>> hits = index.search("value12345");
+    QCOMPARE(hits.count(), 1);
+    QCOMPARE(hits.first(), QVector<int>() << 0 << 12345);
+
+    hits = index.search("data", SearchIndex::Prefix, SearchIndex::Keys);
+    QCOMPARE(hits.count(), 1);
+    QCOMPARE(hits.first(), QVector<int>() << 0);
+
+    // edits inside data only rebuild their buckets
+    QModelIndex value = model.indexForPointer("/data/100");
+    QVERIFY(model.setData(value.sibling(value.row(), VariantTreeModel::ValueColumn), QString("needle")));
+    QModelIndex dataIndex = model.indexForPointer("/data");
+    QVERIFY(model.removeRows(0, 10, dataIndex));
+    QVERIFY(!index.isReady());
+
+    QTRY_VERIFY_WITH_TIMEOUT(index.isReady(), 10000);
+
+    hits = index.search("needle");
+    QCOMPARE(hits.count(), 1);
+    QCOMPARE(hits.first(), QVector<int>() << 0 << 90);
+
+    hits = index.search("value12345");
+    QCOMPARE(hits.count(), 1);
+    QCOMPARE(hits.first(), QVector<int>() << 0 << 12335);
+
+    QVERIFY(index.search("value5", SearchIndex::Prefix).count() > 1000);
+    QCOMPARE(index.search("b").count(), 1);
+}
+
+void TestVariantTree::yamlNumberRoundTrip()
+{
+    QVariantMap numbers;
+    numbers.insert("double", 1.0);
+    numbers.insert("fraction", 2.5);
+    numbers.insert("exponent", 1e300);
+    numbers.insert("float", 3.0f);
+    numbers.insert("int", 7);
+    numbers.insert("longlong", qlonglong(1) << 40);
+    numbers.insert("ulonglong", qulonglong(ULLONG_MAX));
+
+    VariantTreeModel model;
+    model.loadVariantTree(numbers);
+
+    QByteArray yaml;
+    QBuffer buffer(&yaml);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(model.save(&buffer, VariantTreeModel::Yaml));
+    buffer.close();
+
+    buffer.open(QIODevice::ReadOnly);
+    VariantTreeModel loaded;
+    QVERIFY2(loaded.load(&buffer, VariantTreeModel::Yaml), qPrintable(loaded.errorString()));
+
+    const QVariantMap result = loaded.variantTree().toMap();
+    QCOMPARE(result.count(), numbers.count());
+
+    // YAML has a single float type, floats come back as doubles
+    QCOMPARE(int(result.value("double").type()), int(QVariant::Double));
+    QCOMPARE(result.value("double").toDouble(), 1.0);
+    QCOMPARE(int(result.value("fraction").type()), int(QVariant::Double));
+    QCOMPARE(result.value("fraction").toDouble(), 2.5);
+    QCOMPARE(int(result.value("exponent").type()), int(QVariant::Double));
+    QCOMPARE(result.value("exponent").toDouble(), 1e300);
+    QCOMPARE(int(result.value("float").type()), int(QVariant::Double));
+    QCOMPARE(result.value("float").toFloat(), 3.0f);
+
+    QCOMPARE(int(result.value("int").type()), int(QVariant::Int));
+    QCOMPARE(result.value("int").toInt(), 7);
+    QCOMPARE(int(result.value("longlong").type()), int(QVariant::LongLong));
+    QCOMPARE(result.value("longlong").toLongLong(), qlonglong(1) << 40);
+    QCOMPARE(int(result.value("ulonglong").type()), int(QVariant::ULongLong));
+    QCOMPARE(result.value("ulonglong").toULongLong(), qulonglong(ULLONG_MAX));
+}
+
+void TestVariantTree::binaryRoundTrip_data()
+{
+    QTest::addColumn<int>("format");
+
+    QTest::newRow("cbor") << int(VariantTreeModel::Cbor);
+    QTest::newRow("msgpack") << int(VariantTreeModel::MessagePack);
+}
+
+void TestVariantTree::binaryRoundTrip()
+{
+    QFETCH(int, format);
+
+    QDateTime timestamp = QDateTime::fromMSecsSinceEpoch(Q_INT64_C(1600000000123), Qt::UTC);
+
+    QVariantMap values;
+    values.insert("int64", -(qlonglong(1) << 40));
+    values.insert("uint64", qulonglong(LLONG_MAX) + 1000);
+    values.insert("float", 1.5f);
+    values.insert("double", 0.1);
+    values.insert("timestamp", timestamp);
+
+    VariantTreeModel model;
+    model.loadVariantTree(values);
+
+    VariantTreeModel loaded;
+    QVERIFY2(roundTrip(model, VariantTreeModel::DocumentFormat(format), loaded), qPrintable(loaded.errorString()));
+    QVERIFY(!loaded.isMultiDocument());
+
+    const QVariantMap result = loaded.variantTree().toMap();
+    QCOMPARE(result.count(), values.count());
+
+    QCOMPARE(int(result.value("int64").type()), int(QVariant::LongLong));
+    QCOMPARE(result.value("int64").toLongLong(), -(qlonglong(1) << 40));
+    QCOMPARE(int(result.value("uint64").type()), int(QVariant::ULongLong));
+    QCOMPARE(result.value("uint64").toULongLong(), qulonglong(LLONG_MAX) + 1000);
+
+    // both formats have single and double precision floats
+    QCOMPARE(int(result.value("float").type()), int(QMetaType::Float));
+    QCOMPARE(result.value("float").toFloat(), 1.5f);
+    QCOMPARE(int(result.value("double").type()), int(QVariant::Double));
+    QCOMPARE(result.value("double").toDouble(), 0.1);
+
+    QCOMPARE(int(result.value("timestamp").type()), int(QVariant::DateTime));
+    QCOMPARE(result.value("timestamp").toDateTime(), timestamp);
+}
+
+void TestVariantTree::binaryMultiDocument_data()
+{
+    binaryRoundTrip_data();
+}
+
+void TestVariantTree::binaryMultiDocument()
+{
+    QFETCH(int, format);
+
+    QVariantMap first;
+    first.insert("name", QString("first"));
+    QVariantList second = QVariantList() << 1 << 2;
+
+    // two documents written one after the other form a stream
+    QByteArray stream;
+    for (const QVariant& document : QVariantList() << first << second) {
+        VariantTreeModel model;
+        model.loadVariantTree(document);
+
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QVERIFY(model.save(&buffer, VariantTreeModel::DocumentFormat(format)));
+        stream += buffer.data();
+    }
+
+    QBuffer buffer(&stream);
+    buffer.open(QIODevice::ReadOnly);
+    VariantTreeModel model;
+    QVERIFY2(model.load(&buffer, VariantTreeModel::DocumentFormat(format)), qPrintable(model.errorString()));
+    QVERIFY(model.isMultiDocument());
+    QCOMPARE(model.variantTree(), QVariant(QVariantList() << first << second));
+
+    // and are saved as a stream again
+    VariantTreeModel loaded;
+    QVERIFY2(roundTrip(model, VariantTreeModel::DocumentFormat(format), loaded), qPrintable(loaded.errorString()));
+    QVERIFY(loaded.isMultiDocument());
+    QCOMPARE(loaded.variantTree(), model.variantTree());
+}
+
+void TestVariantTree::binaryMalformed_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<QByteArray>("data");
+
+    // an array claiming 2^64 - 1 or 2^32 - 1 elements, with none following
+    QTest::newRow("cbor length") << int(VariantTreeModel::Cbor) << QByteArray::fromHex("9bffffffffffffffff");
+    QTest::newRow("msgpack length") << int(VariantTreeModel::MessagePack) << QByteArray::fromHex("ddffffffff");
+    QTest::newRow("cbor string length") << int(VariantTreeModel::Cbor) << QByteArray::fromHex("7bffffffffffffffff61");
+    QTest::newRow("msgpack string length") << int(VariantTreeModel::MessagePack) << QByteArray::fromHex("dbffffffff61");
+
+    // a document cut off in the middle
+    QTest::newRow("cbor truncated") << int(VariantTreeModel::Cbor) << QByteArray::fromHex("a26161016162");
+    QTest::newRow("msgpack truncated") << int(VariantTreeModel::MessagePack) << QByteArray::fromHex("82a16101a162");
+
+    // nesting far beyond the limit, tags for CBOR and arrays for MessagePack
+    QTest::newRow("cbor tag chain") << int(VariantTreeModel::Cbor) << QByteArray(1 << 20, char(0xc6)).append(char(0x00));
+    QTest::newRow("msgpack nesting") << int(VariantTreeModel::MessagePack) << QByteArray(1 << 20, char(0x91)).append(char(0x00));
+}
+
+void TestVariantTree::binaryMalformed()
+{
+    QFETCH(int, format);
+    QFETCH(QByteArray, data);
+
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+
+    VariantTreeModel model;
+    QVERIFY(!model.load(&buffer, VariantTreeModel::DocumentFormat(format)));
+    QVERIFY(!model.errorString().isEmpty());
+    QVERIFY(!model.isIoError());
+}
+
+void TestVariantTree::undoRemove()
+{
+    VariantTreeModel model;
+    model.loadVariantTree(undoDocument());
+    QVariant before = model.variantTree();
+
+    QVERIFY(model.removeRows(1, 1, model.indexForPointer("/list")));
+
+    QVariantMap after = undoDocument();
+    after.insert("list", QVariantList() << 1 << 3);
+    compareUndoRedo(model, before, after);
+}
+
+void TestVariantTree::undoMoveAcrossParents()
+{
+    VariantTreeModel model;
+    model.loadVariantTree(undoDocument());
+    QVariant before = model.variantTree();
+
+    QVERIFY(model.moveRows(model.indexForPointer("/list"), 0, 2, model.indexForPointer("/other"), 0));
+
+    QVariantMap after = undoDocument();
+    after.insert("list", QVariantList() << 3);
+    after.insert("other", QVariantList() << 1 << 2);
+    compareUndoRedo(model, before, after);
+}
+
+void TestVariantTree::undoTypeConversion()
+{
+    VariantTreeModel model;
+    model.loadVariantTree(undoDocument());
+    QVariant before = model.variantTree();
+
+    // a scalar
+    QModelIndex item = model.indexForPointer("/list/0");
+    QVERIFY(model.setData(item.sibling(item.row(), VariantTreeModel::TypeColumn), uint(QVariant::String)));
+
+    QVariantMap after = undoDocument();
+    after.insert("list", QVariantList() << QString("1") << 2 << 3);
+    compareUndoRedo(model, before, after);
+
+    // an object with childs
+    before = model.variantTree();
+    QModelIndex object = model.indexForPointer("/object");
+    QVERIFY(model.setData(object.sibling(object.row(), VariantTreeModel::TypeColumn), uint(QVariant::List)));
+
+    after.insert("object", QVariantList() << true << QString("text"));
+    compareUndoRedo(model, before, after);
+}
+
+void TestVariantTree::undoKeyRename()
+{
+    VariantTreeModel model;
+    model.loadVariantTree(undoDocument());
+    QVariant before = model.variantTree();
+
+    // the renamed member sorts after its sibling now
+    QModelIndex member = model.indexForPointer("/object/x");
+    QVERIFY(model.setData(member.sibling(member.row(), VariantTreeModel::KeyColumn), QString("z")));
+
+    QVariantMap object;
+    object.insert("y", QString("text"));
+    object.insert("z", true);
+    QVariantMap after = undoDocument();
+    after.insert("object", object);
+    compareUndoRedo(model, before, after);
+}
+
+QTEST_GUILESS_MAIN(TestVariantTree)
+
+#include "tst_varianttree.moc"